@@ -0,0 +1,106 @@
+#include "arena.h"
+#include <stdlib.h> // malloc
+
+namespace dmFontGen
+{
+
+static const uint32_t ARENA_ALIGNMENT = 16;
+
+struct Arena
+{
+    uint8_t*    m_Memory;
+    uint32_t    m_Capacity;
+    uint32_t    m_Used;
+    uint32_t    m_LastOffset;   // The offset of the last allocation, which can be reclaimed by ArenaFree()
+    uint32_t    m_Overflow;     // The number of bytes allocated with malloc since the last reset
+    uint32_t    m_HighWater;
+};
+
+static inline uint32_t Align(uint32_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static inline bool IsInArena(Arena* arena, void* memory)
+{
+    uint8_t* p = (uint8_t*)memory;
+    return p >= arena->m_Memory && p < arena->m_Memory + arena->m_Capacity;
+}
+
+Arena* ArenaCreate(uint32_t capacity)
+{
+    Arena* arena = (Arena*)malloc(sizeof(Arena));
+    arena->m_Capacity = Align(capacity);
+    arena->m_Memory = (uint8_t*)malloc(arena->m_Capacity);
+    arena->m_Used = 0;
+    arena->m_LastOffset = 0;
+    arena->m_Overflow = 0;
+    arena->m_HighWater = 0;
+    return arena;
+}
+
+void ArenaDelete(Arena* arena)
+{
+    if (!arena)
+        return;
+    free(arena->m_Memory);
+    free(arena);
+}
+
+void* ArenaAlloc(Arena* arena, size_t size)
+{
+    if (!arena)
+        return malloc(size);
+
+    uint32_t aligned_size = Align((uint32_t)size);
+    uint32_t used = arena->m_Used + aligned_size;
+    if (used > arena->m_Capacity)
+    {
+        arena->m_Overflow += aligned_size;
+        uint32_t total = arena->m_Used + arena->m_Overflow;
+        if (total > arena->m_HighWater)
+            arena->m_HighWater = total;
+        return malloc(size);
+    }
+
+    void* memory = arena->m_Memory + arena->m_Used;
+    arena->m_LastOffset = arena->m_Used;
+    arena->m_Used = used;
+    if (used + arena->m_Overflow > arena->m_HighWater)
+        arena->m_HighWater = used + arena->m_Overflow;
+    return memory;
+}
+
+void ArenaFree(Arena* arena, void* memory)
+{
+    if (!arena || !IsInArena(arena, memory))
+    {
+        free(memory);
+        return;
+    }
+
+    // stb_truetype often frees the last allocation, e.g. when growing the vertex arrays of a compound glyph
+    if (memory == arena->m_Memory + arena->m_LastOffset)
+        arena->m_Used = arena->m_LastOffset;
+}
+
+void ArenaReset(Arena* arena)
+{
+    if (arena->m_HighWater > arena->m_Capacity)
+    {
+        // Grow to fit the largest job so far, while the arena is empty
+        free(arena->m_Memory);
+        arena->m_Capacity = Align(arena->m_HighWater);
+        arena->m_Memory = (uint8_t*)malloc(arena->m_Capacity);
+    }
+    arena->m_Used = 0;
+    arena->m_LastOffset = 0;
+    arena->m_Overflow = 0;
+}
+
+uint32_t ArenaGetHighWater(Arena* arena)
+{
+    return arena->m_HighWater;
+}
+
+} // namespace
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace dmFontGen
+{
+    /*
+     * A bump allocator for the short lived scratch memory of a glyph job (e.g. the stb_truetype allocations).
+     * It's not thread safe, each worker uses its own arena, and resets it after each job.
+     * Allocations that don't fit fall back to malloc, and the arena grows to the high water mark on the next reset
+     */
+    struct Arena;
+
+    Arena*   ArenaCreate(uint32_t capacity);
+    void     ArenaDelete(Arena* arena);
+
+    /*
+     * Allocates size bytes (16 byte aligned). If arena is 0, malloc is used
+     */
+    void*    ArenaAlloc(Arena* arena, size_t size);
+
+    /*
+     * Frees the memory if it was allocated with malloc. The arena memory is only reclaimed
+     * if it was the last allocation, or when the arena is reset
+     */
+    void     ArenaFree(Arena* arena, void* memory);
+
+    void     ArenaReset(Arena* arena);
+
+    /*
+     * The max number of bytes used between two resets, including the malloc fallbacks
+     */
+    uint32_t ArenaGetHighWater(Arena* arena);
+}
@@ -0,0 +1,245 @@
+#include "disk_cache.h"
+
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/atomic.h>
+#include <dmsdk/dlib/hash.h>
+#include <dmsdk/dlib/hashtable.h>
+#include <dmsdk/dlib/log.h>
+#include <dmsdk/dlib/math.h>
+#include <dmsdk/dlib/mutex.h>
+
+#include <stdio.h>  // fopen
+#include <stdlib.h> // malloc
+#include <string.h> // memcpy
+
+namespace dmFontGen
+{
+
+static const uint32_t DISK_CACHE_MAGIC   = 0x43444746; // "FGDC"
+static const uint32_t DISK_CACHE_VERSION = 1;
+
+struct FileHeader
+{
+    uint32_t    m_Magic;
+    uint32_t    m_Version;
+};
+
+// Followed by m_Size bytes of data
+struct RecordHeader
+{
+    uint64_t    m_Key;
+    uint32_t    m_Size;
+    uint32_t    m_Checksum;
+};
+
+struct Record
+{
+    uint32_t    m_Offset;   // The offset of the data in the file
+    uint32_t    m_Size;
+};
+
+struct DiskCache
+{
+    dmMutex::HMutex         m_Mutex;
+    FILE*                   m_File;
+    dmHashTable64<Record>   m_Records;
+    uint32_t                m_FileSize;
+    uint32_t                m_MaxSize;
+    int32_atomic_t          m_Hits;
+    int32_atomic_t          m_Misses;
+};
+
+static uint32_t Checksum(uint64_t key, const uint8_t* data, uint32_t size)
+{
+    return dmHashBuffer32(data, size) ^ (uint32_t)key ^ (uint32_t)(key >> 32);
+}
+
+static uint8_t* ReadFile(const char* path, uint32_t* size)
+{
+    *size = 0;
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = 0;
+    if (file_size > 0)
+    {
+        data = (uint8_t*)malloc(file_size);
+        *size = (uint32_t)fread(data, 1, file_size, file);
+    }
+    fclose(file);
+    return data;
+}
+
+static void PutRecord(DiskCache* cache, uint64_t key, uint32_t offset, uint32_t size)
+{
+    if (cache->m_Records.Full())
+    {
+        uint32_t cap = cache->m_Records.Capacity() + 256;
+        cache->m_Records.SetCapacity((cap*2)/3, cap);
+    }
+    Record record = { offset, size };
+    cache->m_Records.Put(key, record);
+}
+
+DiskCache* DiskCacheOpen(const char* path, uint32_t max_size)
+{
+    uint32_t contents_size = 0;
+    uint8_t* contents = ReadFile(path, &contents_size);
+
+    FileHeader file_header = { DISK_CACHE_MAGIC, DISK_CACHE_VERSION };
+    bool valid_header = contents_size >= sizeof(FileHeader) && memcmp(contents, &file_header, sizeof(FileHeader)) == 0;
+
+    // Validate the records. Everything after the first invalid one is dropped (e.g. an interrupted write)
+    dmArray<uint32_t> offsets;
+    uint32_t end = sizeof(FileHeader);
+    while (valid_header && end + sizeof(RecordHeader) <= contents_size)
+    {
+        RecordHeader header;
+        memcpy(&header, contents + end, sizeof(header));
+        if (header.m_Size > contents_size - end - sizeof(header))
+            break;
+        if (header.m_Checksum != Checksum(header.m_Key, contents + end + sizeof(header), header.m_Size))
+            break;
+
+        if (offsets.Full())
+            offsets.OffsetCapacity(dmMath::Max(256U, offsets.Capacity()));
+        offsets.Push(end);
+        end += sizeof(header) + header.m_Size;
+    }
+
+    // When it's over the max size, only the newest records are kept, within half the max size to leave room for new glyphs
+    uint32_t first = 0;
+    if (end > max_size)
+    {
+        uint32_t size = sizeof(FileHeader);
+        first = offsets.Size();
+        while (first > 0)
+        {
+            uint32_t next_offset = first < offsets.Size() ? offsets[first] : end;
+            uint32_t record_size = next_offset - offsets[first - 1];
+            if (size + record_size > max_size / 2)
+                break;
+            size += record_size;
+            --first;
+        }
+    }
+
+    bool rewrite = !valid_header || end != contents_size || first > 0;
+    if (rewrite)
+    {
+        FILE* file = fopen(path, "wb");
+        if (!file)
+        {
+            dmLogWarning("Failed to create glyph cache '%s'", path);
+            free((void*)contents);
+            return 0;
+        }
+        fwrite(&file_header, 1, sizeof(file_header), file);
+        if (first < offsets.Size())
+            fwrite(contents + offsets[first], 1, end - offsets[first], file);
+        fclose(file);
+    }
+
+    DiskCache* cache = new DiskCache;
+    cache->m_File = fopen(path, "r+b");
+    if (!cache->m_File)
+    {
+        dmLogWarning("Failed to open glyph cache '%s'", path);
+        free((void*)contents);
+        delete cache;
+        return 0;
+    }
+    cache->m_Mutex = dmMutex::New();
+    cache->m_MaxSize = max_size;
+    cache->m_Hits = 0;
+    cache->m_Misses = 0;
+
+    // The kept records are contiguous, and start right after the file header
+    uint32_t offset = sizeof(FileHeader);
+    for (uint32_t i = first; i < offsets.Size(); ++i)
+    {
+        RecordHeader header;
+        memcpy(&header, contents + offsets[i], sizeof(header));
+        PutRecord(cache, header.m_Key, offset + sizeof(header), header.m_Size);
+        offset += sizeof(header) + header.m_Size;
+    }
+    cache->m_FileSize = offset;
+
+    free((void*)contents);
+    return cache;
+}
+
+void DiskCacheClose(DiskCache* cache)
+{
+    fclose(cache->m_File);
+    dmMutex::Delete(cache->m_Mutex);
+    delete cache;
+}
+
+uint8_t* DiskCacheGet(DiskCache* cache, uint64_t key, uint32_t* size)
+{
+    DM_MUTEX_SCOPED_LOCK(cache->m_Mutex);
+    Record* record = cache->m_Records.Get(key);
+    if (!record)
+    {
+        dmAtomicIncrement32(&cache->m_Misses);
+        return 0;
+    }
+
+    uint8_t* data = (uint8_t*)malloc(dmMath::Max(1U, record->m_Size));
+    if (fseek(cache->m_File, record->m_Offset, SEEK_SET) != 0 ||
+        fread(data, 1, record->m_Size, cache->m_File) != record->m_Size)
+    {
+        free((void*)data);
+        dmAtomicIncrement32(&cache->m_Misses);
+        return 0;
+    }
+
+    dmAtomicIncrement32(&cache->m_Hits);
+    *size = record->m_Size;
+    return data;
+}
+
+bool DiskCachePut(DiskCache* cache, uint64_t key, const uint8_t* data, uint32_t size)
+{
+    DM_MUTEX_SCOPED_LOCK(cache->m_Mutex);
+    if (cache->m_Records.Get(key))
+        return true; // E.g. another font with the same ttf and settings
+
+    RecordHeader header;
+    header.m_Key = key;
+    header.m_Size = size;
+    header.m_Checksum = Checksum(key, data, size);
+
+    if (cache->m_FileSize + sizeof(header) + size > cache->m_MaxSize)
+        return false; // Full until the next time it's opened
+
+    bool ok = fseek(cache->m_File, cache->m_FileSize, SEEK_SET) == 0 &&
+              fwrite(&header, 1, sizeof(header), cache->m_File) == sizeof(header) &&
+              fwrite(data, 1, size, cache->m_File) == size &&
+              fflush(cache->m_File) == 0;
+    if (!ok)
+    {
+        // The partial record is dropped the next time the file is opened
+        dmLogWarning("Failed to write to the glyph cache, it's disabled until the next launch");
+        cache->m_MaxSize = 0;
+        return false;
+    }
+
+    PutRecord(cache, key, cache->m_FileSize + sizeof(header), size);
+    cache->m_FileSize += sizeof(header) + size;
+    return true;
+}
+
+void DiskCacheGetStats(DiskCache* cache, uint32_t* hits, uint32_t* misses)
+{
+    *hits = (uint32_t)dmAtomicGet32(&cache->m_Hits);
+    *misses = (uint32_t)dmAtomicGet32(&cache->m_Misses);
+}
+
+} // namespace
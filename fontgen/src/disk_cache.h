@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace dmFontGen
+{
+    /*
+     * A persistent cache of generated glyphs, stored in a single append-only file.
+     * Each record is a 64 bit key and a blob, protected by a checksum. When the file is opened, the records are validated,
+     * and a corrupt or truncated tail is dropped. If the file is over its max size, only the newest records are kept.
+     * Once the max size is reached, new records are skipped until the next time the cache is opened.
+     * All functions are thread safe
+     */
+    struct DiskCache;
+
+    /*
+     * Opens (or creates) the cache file. Returns 0 if the file can't be created
+     */
+    DiskCache* DiskCacheOpen(const char* path, uint32_t max_size);
+    void       DiskCacheClose(DiskCache* cache);
+
+    /*
+     * Returns a copy of the blob (allocated with malloc), or 0 if the key isn't found
+     */
+    uint8_t*   DiskCacheGet(DiskCache* cache, uint64_t key, uint32_t* size);
+
+    /*
+     * Appends the blob to the file. Returns false if the cache is full, or the write failed
+     */
+    bool       DiskCachePut(DiskCache* cache, uint64_t key, const uint8_t* data, uint32_t size);
+
+    /*
+     * Gets the number of lookups that found a record, and the ones that didn't, since the cache was opened
+     */
+    void       DiskCacheGetStats(DiskCache* cache, uint32_t* hits, uint32_t* misses);
+}
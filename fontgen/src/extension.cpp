@@ -13,7 +13,16 @@ static int LoadFont(lua_State* L)
     const char* fontc_path = luaL_checkstring(L, 1); // dmScript::CheckHash(L, 1);
     const char* ttf_path = luaL_checkstring(L, 2); //dmScript::CheckHash(L, 2);
 
-    if (!dmFontGen::LoadFont(fontc_path, ttf_path))
+    const char* sdf_algorithm = 0;
+    if (lua_istable(L, 3))
+    {
+        lua_getfield(L, 3, "sdf_algorithm");
+        if (!lua_isnil(L, -1))
+            sdf_algorithm = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+    }
+
+    if (!dmFontGen::LoadFont(fontc_path, ttf_path, sdf_algorithm))
     {
         lua_pushnil(L); // No font
         lua_pushfstring(L, "Failed to load one of fonts: %s / %s", fontc_path, ttf_path);
@@ -55,7 +64,7 @@ static void AddGlyphsCallback(void* _ctx, int result, const char* errmsg)
     {
         int nargs = 3;
         lua_pushinteger(L, (int)ctx->m_Request);
-        lua_pushboolean(L, result != 0);
+        lua_pushboolean(L, result == dmFontGen::GLYPH_RESULT_OK);
         if (0 != errmsg)
             lua_pushstring(L, errmsg);
         else
@@ -69,6 +78,19 @@ static void AddGlyphsCallback(void* _ctx, int result, const char* errmsg)
     delete ctx;
 }
 
+static dmFontGen::Priority CheckPriority(lua_State* L, int index)
+{
+    const char* priority = luaL_checkstring(L, index);
+    if (strcmp(priority, "urgent") == 0)
+        return dmFontGen::PRIORITY_URGENT;
+    if (strcmp(priority, "normal") == 0)
+        return dmFontGen::PRIORITY_NORMAL;
+    if (strcmp(priority, "idle") == 0)
+        return dmFontGen::PRIORITY_IDLE;
+    luaL_error(L, "Unknown priority '%s'. Expected \"urgent\", \"normal\" or \"idle\"", priority);
+    return dmFontGen::PRIORITY_NORMAL;
+}
+
 static int AddGlyphs(lua_State* L)
 {
     DM_LUA_STACK_CHECK(L, 1);
@@ -77,14 +99,20 @@ static int AddGlyphs(lua_State* L)
     dmhash_t fontc_path_hash = dmScript::CheckHashOrString(L, 1);
     const char* text = luaL_checkstring(L, 2);
 
+    dmFontGen::Priority priority = dmFontGen::PRIORITY_NORMAL;
+    if (lua_istable(L, 4))
+    {
+        lua_getfield(L, 4, "priority");
+        if (!lua_isnil(L, -1))
+            priority = CheckPriority(L, -1);
+        lua_pop(L, 1);
+    }
+
     dmScript::LuaCallbackInfo* luacbk = 0;
     if (top > 2 && !lua_isnil(L, 3)) {
         luacbk = dmScript::CreateCallback(L, 3);
     }
 
-    static int requests = 1;
-    int request_id = requests++;
-
     dmFontGen::FGlyphCallback callback = 0;
     CallbackContext* cbk_ctx = 0;
     if (luacbk)
@@ -92,18 +120,35 @@ static int AddGlyphs(lua_State* L)
         callback = AddGlyphsCallback;
         cbk_ctx = new CallbackContext;
         cbk_ctx->m_Callback  = luacbk;
-        cbk_ctx->m_Request = request_id;
     }
 
-    if (!dmFontGen::AddGlyphs(fontc_path_hash, text, callback, cbk_ctx))
+    // The callback is never called from within AddGlyphs(), so the request id can be set afterwards
+    uint32_t request_id = dmFontGen::AddGlyphs(fontc_path_hash, text, priority, callback, cbk_ctx);
+    if (!request_id)
     {
+        if (luacbk)
+        {
+            dmScript::DestroyCallback(luacbk);
+            delete cbk_ctx;
+        }
         return luaL_error(L, "Failed to add glyphs to font %s", dmHashReverseSafe64(fontc_path_hash));
     }
+    if (cbk_ctx)
+        cbk_ctx->m_Request = request_id;
 
     lua_pushinteger(L, request_id);
     return 1;
 }
 
+static int Cancel(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 1);
+
+    uint32_t request_id = (uint32_t)luaL_checkinteger(L, 1);
+    lua_pushboolean(L, dmFontGen::Cancel(request_id));
+    return 1;
+}
+
 static int RemoveGlyphs(lua_State* L)
 {
     DM_LUA_STACK_CHECK(L, 0);
@@ -117,13 +162,61 @@ static int RemoveGlyphs(lua_State* L)
     return 0;
 }
 
+static int TouchGlyphs(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 0);
+
+    dmhash_t fontc_path_hash = dmScript::CheckHashOrString(L, 1);
+    const char* text = luaL_checkstring(L, 2);
+
+    if (!dmFontGen::TouchGlyphs(fontc_path_hash, text))
+        return luaL_error(L, "Failed to touch glyphs in font %s", dmHashReverseSafe64(fontc_path_hash));
+
+    return 0;
+}
+
+static int GetStats(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 1);
+    dmFontGen::Stats stats;
+    dmFontGen::GetStats(&stats);
+
+    lua_newtable(L);
+    lua_pushinteger(L, stats.m_ArenaHighWater);
+    lua_setfield(L, -2, "arena_high_water");
+    lua_pushinteger(L, stats.m_OutlineCacheHits);
+    lua_setfield(L, -2, "outline_cache_hits");
+    lua_pushinteger(L, stats.m_OutlineCacheMisses);
+    lua_setfield(L, -2, "outline_cache_misses");
+    lua_pushinteger(L, stats.m_UpdateDeferredFrames);
+    lua_setfield(L, -2, "update_deferred_frames");
+    lua_pushinteger(L, stats.m_UpdateDeferredGlyphs);
+    lua_setfield(L, -2, "update_deferred_glyphs");
+    lua_pushinteger(L, stats.m_UpdateMaxDeferred);
+    lua_setfield(L, -2, "update_max_deferred");
+    lua_pushinteger(L, stats.m_GlyphsEvicted);
+    lua_setfield(L, -2, "glyphs_evicted");
+    lua_pushinteger(L, stats.m_DiskCacheHits);
+    lua_setfield(L, -2, "disk_cache_hits");
+    lua_pushinteger(L, stats.m_DiskCacheMisses);
+    lua_setfield(L, -2, "disk_cache_misses");
+    lua_pushinteger(L, stats.m_DistanceCacheHits);
+    lua_setfield(L, -2, "distance_cache_hits");
+    lua_pushinteger(L, stats.m_DistanceCacheMisses);
+    lua_setfield(L, -2, "distance_cache_misses");
+    return 1;
+}
+
 // Functions exposed to Lua
 static const luaL_reg Module_methods[] =
 {
     {"load_font", LoadFont},
     {"unload_font", UnloadFont},
     {"add_glyphs", AddGlyphs},
+    {"cancel", Cancel},
     {"remove_glyphs", RemoveGlyphs},
+    {"touch_glyphs", TouchGlyphs},
+    {"get_stats", GetStats},
     {0, 0}
 };
 
@@ -1,42 +1,121 @@
+#include <stdlib.h> // qsort
+
 #include <dmsdk/sdk.h>
+#include <dmsdk/dlib/atomic.h>
 #include <dmsdk/dlib/hash.h>
 #include <dmsdk/dlib/hashtable.h>
+#include <dmsdk/dlib/sys.h>
 #include <dmsdk/dlib/utf8.h>
 
 #include <dmsdk/gamesys/resources/res_font.h>
 
+#include "arena.h"
+#include "disk_cache.h"
+#include "pool.h"
 #include "res_ttf.h"
+#include "util.h" // GetCpuCount
 #include "fontgen.h"
 #include "job_thread.h"
 
 namespace dmFontGen
 {
 
+enum GlyphState
+{
+    GLYPH_STATE_QUEUED,     // Generated by m_Job
+    GLYPH_STATE_ADDED,      // In the font
+    GLYPH_STATE_EVICTED,    // Removed from the font to make room for other glyphs, it's queued again when it's used
+    GLYPH_STATE_MISSING,    // The job was cancelled or failed, it's queued again when it's requested
+};
+
+// A glyph added (or queued) by fontgen. The entry is kept while the glyph has references, even if it's not in the font
+struct GlyphEntry
+{
+    struct JobItem* m_Job;      // The job generating the glyph, only set while it's GLYPH_STATE_QUEUED
+    GlyphState      m_State;
+    uint32_t        m_RefCount; // Number of add_glyphs calls, not yet matched by a remove_glyphs call
+    uint32_t        m_Serial;   // The last add/remove call that counted the glyph, so repeated characters are counted once
+    uint32_t        m_LastUse;  // The frame the glyph was last added or touched
+    uint32_t        m_Size;     // The size (bytes) of the glyph image, once it's added to the font
+};
+
+// The font info is reference counted by the loaded font, and by each job item in flight.
+// The references are only released on the main thread, so the resources are always released there
 struct FontInfo
 {
-    dmMutex::HMutex             m_Mutex;
+    dmMutex::HMutex             m_Mutex;        // Only held while publishing glyphs to the font resource
+    dmhash_t                    m_PathHash;
     dmGameSystem::FontResource* m_FontResource;
     dmFontGen::TTFResource*     m_TTFResource;
-    int                         m_Padding;
+    int                         m_Padding;      // The pixels around each glyph image
+    int                         m_Spread;       // The distance (pixels) from the outline to the 0 value of the sdf (see GenerateGlyphSdf())
     int                         m_EdgeValue;
+    float                       m_ShadowBlur;   // The blur radius (pixels) of the shadow channel
+    uint32_t                    m_FontSize;
     float                       m_Scale;
+    SdfAlgorithm                m_SdfAlgorithm;
+    int32_atomic_t              m_RefCount;
+    int32_atomic_t              m_Deleted;      // Set when the font is unloaded, the workers skip any remaining glyphs
+    dmHashTable32<GlyphEntry>   m_Glyphs;       // The glyphs added or queued by fontgen, by codepoint. Main thread only
+    uint32_t                    m_GlyphsSize;   // The total size (bytes) of the glyph images added by fontgen
 
     uint8_t                     m_IsSdf:1;
     uint8_t                     m_HasShadow:1;
-    uint8_t                     m_Deleted:1;
 };
 
 struct Context
 {
-    dmMutex::HMutex             m_Mutex;
     HResourceFactory            m_ResourceFactory;
     dmHashTable64<FontInfo*>    m_FontInfos;        // Loaded .fontc files
-    dmHashTable64<FontInfo*>    m_DeletedFontInfos; // Unloaded .fontc files about to be deleted
+    dmArray<FontInfo*>          m_DeletedFontInfos; // Unloaded .fontc files, still referenced by job items. The same .fontc may be unloaded several times
     dmJobThread::HContext       m_Jobs;
     uint8_t                     m_DefaultSdfPadding;
     uint8_t                     m_DefaultSdfEdge;
+    SdfAlgorithm                m_DefaultSdfAlgorithm;
+    uint32_t                    m_SdfParallelCost;  // Glyphs with a higher cost (pixels * segments) are generated by several workers
+    dmArray<Arena*>             m_Arenas;           // Scratch memory, one per worker
+    int32_atomic_t*             m_ArenasInUse;
+    DiskCache*                  m_DiskCache;        // The generated glyphs from previous runs. May be 0
+    ObjectPool<struct JobItem>   m_ItemPool;        // The job items and statuses are recycled, so there are no allocations per glyph
+    ObjectPool<struct JobStatus> m_StatusPool;
+    ObjectPool<struct JobWaiter> m_WaiterPool;
+    dmArray<void*>              m_PushItems;        // Scratch array for submitting the items of a request
+    dmHashTable32<struct JobStatus*> m_Requests;    // The unfinished add_glyphs requests, by request id
+    dmArray<struct JobStatus*>  m_FinishedRequests; // Requests without any new glyphs, their callbacks are called in the next Update()
+    uint32_t                    m_NextRequestId;
+    uint32_t                    m_GlyphSerial;      // Incremented for each add/remove call, see GlyphEntry
+    uint32_t                    m_Frame;            // Incremented each Update(), for the glyph last use
+    uint32_t                    m_GlyphBudget;      // Max size (bytes) of the glyph images added to each font. 0 means no limit
+    dmArray<struct EvictCandidate> m_EvictCandidates; // Scratch array for EvictGlyphs()
+    uint32_t                    m_GlyphsEvicted;
+    uint32_t                    m_UpdateBudget;     // Max time (us) spent on finished glyphs each frame. 0 means no limit
+    uint32_t                    m_UpdateDeferredFrames; // Number of updates that ran out of time
+    uint32_t                    m_UpdateDeferredGlyphs; // Number of finished glyphs left for the next frame, summed over all updates
+    uint32_t                    m_UpdateMaxDeferred;    // Max number of finished glyphs left for the next frame
 };
 
+static const uint32_t ARENA_INITIAL_SIZE = 64 * 1024;
+static const uint32_t INVALID_ARENA_INDEX = 0xFFFFFFFF;
+
+// The engine's main thread, and its own workers (e.g. sound and resource loading)
+static const uint32_t ENGINE_THREAD_COUNT = 2;
+
+static uint32_t GetWorkerThreadCount(const char* value)
+{
+    int count;
+    if (strcmp(value, "auto") == 0)
+    {
+        count = (int)GetCpuCount() - (int)ENGINE_THREAD_COUNT;
+    }
+    else
+    {
+        count = atoi(value);
+        if (count < 1)
+            dmLogWarning("Invalid fontgen.worker_threads '%s', using 1", value);
+    }
+    return (uint32_t)dmMath::Clamp(count, 1, (int)dmJobThread::DM_MAX_JOB_THREAD_COUNT);
+}
+
 Context* g_FontExtContext = 0;
 
 static const uint32_t ZERO_WIDTH_SPACE_UNICODE = 0x200b;
@@ -48,6 +127,47 @@ static inline bool IsWhiteSpace(uint32_t c)
     return c == ' ' || c == '\n' || c == '\t' || c == ZERO_WIDTH_SPACE_UNICODE || c == NO_BREAK_SPACE_UNICODE || c == IDEOGRAPHIC_SPACE_UNICODE;
 }
 
+// At most one job per worker runs at the same time, so there's always a free arena
+static Arena* AcquireArena(Context* ctx, uint32_t* index)
+{
+    for (uint32_t i = 0; i < ctx->m_Arenas.Size(); ++i)
+    {
+        if (dmAtomicCompareStore32(&ctx->m_ArenasInUse[i], 1, 0) == 0)
+        {
+            *index = i;
+            return ctx->m_Arenas[i];
+        }
+    }
+    return 0; // Uses malloc
+}
+
+static void ReleaseArena(Context* ctx, uint32_t index)
+{
+    if (index == INVALID_ARENA_INDEX)
+        return;
+    ArenaReset(ctx->m_Arenas[index]);
+    dmAtomicStore32(&ctx->m_ArenasInUse[index], 0);
+}
+
+static void ParallelFor(void* _ctx, FParallelProcess process, void* process_ctx, uint32_t count)
+{
+    Context* ctx = (Context*)_ctx;
+    dmJobThread::RunParallel(ctx->m_Jobs, process, process_ctx, count);
+}
+
+static bool GetSdfAlgorithm(const char* name, SdfAlgorithm* algorithm)
+{
+    if (strcmp(name, "analytic") == 0)
+        *algorithm = SDF_ALGORITHM_ANALYTIC;
+    else if (strcmp(name, "raster") == 0)
+        *algorithm = SDF_ALGORITHM_RASTER;
+    else if (strcmp(name, "msdf") == 0)
+        *algorithm = SDF_ALGORITHM_MSDF;
+    else
+        return false;
+    return true;
+}
+
 static bool CheckType(HResourceFactory factory, const char* path, const char** types, uint32_t num_types)
 {
     HResourceDescriptor rd;
@@ -91,42 +211,53 @@ static TTFResource* LoadFontData(Context* ctx, const char* path)
     return resource;
 }
 
-static void ReleaseResources(Context* ctx, FontInfo* info)
+static void ReleaseFontResource(Context* ctx, FontInfo* info)
 {
     if (info->m_FontResource)
         dmResource::Release(ctx->m_ResourceFactory, info->m_FontResource);
     info->m_FontResource = 0;
+}
+
+static void ReleaseResources(Context* ctx, FontInfo* info)
+{
+    ReleaseFontResource(ctx, info);
 
     if (info->m_TTFResource)
         dmResource::Release(ctx->m_ResourceFactory, info->m_TTFResource);
     info->m_TTFResource = 0;
 }
 
-static void DeleteFontNoLock(Context* ctx, FontInfo* info)
+static void DeleteFont(Context* ctx, FontInfo* info)
 {
     ReleaseResources(ctx, info);
+    if (info->m_Mutex)
+        dmMutex::Delete(info->m_Mutex);
     delete info;
 }
 
-static void DeleteFont(Context* ctx, FontInfo* info)
+static void AcquireFontInfo(FontInfo* info)
 {
-    DM_MUTEX_SCOPED_LOCK(info->m_Mutex);
-    DeleteFontNoLock(ctx, info);
+    dmAtomicIncrement32(&info->m_RefCount);
 }
 
-static void DelayDeleteFont(Context* ctx, FontInfo* info, dmhash_t path_hash)
+// Called on the main thread
+static void ReleaseFontInfo(Context* ctx, FontInfo* info)
 {
-    DM_MUTEX_SCOPED_LOCK(info->m_Mutex);
-    // Release resources as early as possible
-    // This will also stop any pending jobs from doing work
-    ReleaseResources(ctx, info);
-    info->m_Deleted = 1;
-    if (ctx->m_DeletedFontInfos.Full())
+    if (dmAtomicDecrement32(&info->m_RefCount) != 1)
+        return;
+
+    if (dmAtomicGet32(&info->m_Deleted))
     {
-        uint32_t cap = ctx->m_DeletedFontInfos.Capacity() + 8;
-        ctx->m_DeletedFontInfos.SetCapacity((cap*3/2), cap);
+        for (uint32_t i = 0; i < ctx->m_DeletedFontInfos.Size(); ++i)
+        {
+            if (ctx->m_DeletedFontInfos[i] == info)
+            {
+                ctx->m_DeletedFontInfos.EraseSwap(i);
+                break;
+            }
+        }
     }
-    ctx->m_DeletedFontInfos.Put(path_hash, info);
+    DeleteFont(ctx, info);
 }
 
 static bool UnloadFont(Context* ctx, dmhash_t fontc_path_hash)
@@ -139,37 +270,58 @@ static bool UnloadFont(Context* ctx, dmhash_t fontc_path_hash)
     }
 
     FontInfo* info = *infop;
-    DelayDeleteFont(ctx, info, fontc_path_hash);
     ctx->m_FontInfos.Erase(fontc_path_hash);
+
+    {
+        // Release the font as early as possible, the workers stop generating glyphs for it
+        // The ttf resource may still be in use by a worker, and is released with the last reference
+        DM_MUTEX_SCOPED_LOCK(info->m_Mutex);
+        ReleaseFontResource(ctx, info);
+        dmAtomicStore32(&info->m_Deleted, 1);
+    }
+
+    if (ctx->m_DeletedFontInfos.Full())
+        ctx->m_DeletedFontInfos.OffsetCapacity(8);
+    ctx->m_DeletedFontInfos.Push(info);
+    ReleaseFontInfo(ctx, info);
     return true;
 }
 
-static FontInfo* LoadFont(Context* ctx, const char* fontc_path, const char* ttf_path)
+static FontInfo* LoadFont(Context* ctx, const char* fontc_path, const char* ttf_path, const char* sdf_algorithm)
 {
     dmhash_t path_hash = dmHashString64(fontc_path);
 
-    FontInfo* info = new FontInfo;
-    memset(info, 0, sizeof(*info));
+    SdfAlgorithm algorithm = ctx->m_DefaultSdfAlgorithm;
+    if (sdf_algorithm && !GetSdfAlgorithm(sdf_algorithm, &algorithm))
+    {
+        dmLogError("Unknown sdf algorithm '%s' for font '%s'", sdf_algorithm, fontc_path);
+        return 0;
+    }
+
+    FontInfo* info = new FontInfo(); // zero initialized
+    info->m_Mutex = dmMutex::New();
+    info->m_PathHash = path_hash;
+    info->m_RefCount = 1; // The loaded font
 
     dmResource::Result r = dmResource::Get(ctx->m_ResourceFactory, fontc_path, (void**)&info->m_FontResource);
     if (dmResource::RESULT_OK != r)
     {
         dmLogError("Failed to get .fontc resource '%s'", fontc_path);
-        DeleteFontNoLock(ctx, info);
+        DeleteFont(ctx, info);
         return 0;
     }
 
     const char* types[] = { "fontc" };
     if (!CheckType(ctx->m_ResourceFactory, fontc_path, types, 1))
     {
-        DeleteFontNoLock(ctx, info);
+        DeleteFont(ctx, info);
         return 0;
     }
 
     info->m_TTFResource = LoadFontData(ctx, ttf_path);
     if (!info->m_TTFResource)
     {
-        DeleteFontNoLock(ctx, info);
+        DeleteFont(ctx, info);
         return 0;
     }
 
@@ -178,36 +330,54 @@ static FontInfo* LoadFont(Context* ctx, const char* fontc_path, const char* ttf_
     if (dmResource::RESULT_OK != r)
     {
         dmLogError("Failed to get font info from '%s'", fontc_path);
-        DeleteFontNoLock(ctx, info);
+        DeleteFont(ctx, info);
         return 0;
     }
 
     if (dmRenderDDF::TYPE_DISTANCE_FIELD != font_info.m_OutputFormat)
     {
         dmLogError("Currently only distance field fonts are supported: %s", fontc_path);
-        DeleteFontNoLock(ctx, info);
+        DeleteFont(ctx, info);
         return 0;
     }
 
-    info->m_Mutex = ctx->m_Mutex;
+    // See Fontc.java. If we have shadow blur, we need 3 channels
+    info->m_HasShadow    = font_info.m_ShadowAlpha > 0.0f && font_info.m_ShadowBlur > 0.0f;
+    if (info->m_HasShadow && algorithm == SDF_ALGORITHM_MSDF)
+    {
+        // The msdf uses all three channels
+        dmLogWarning("Shadow blur isn't supported with the msdf algorithm: %s", fontc_path);
+        info->m_HasShadow = 0;
+    }
 
     info->m_Padding = ctx->m_DefaultSdfPadding;
+    info->m_Spread  = ctx->m_DefaultSdfPadding;
+    info->m_ShadowBlur = 0.0f;
     if (dmRenderDDF::MODE_MULTI_LAYER == font_info.m_RenderMode)
     {
         // see Fontc.java
         const float rootOf2 = sqrtf(2.0f);
 
+        // The outline and shadow thresholds of the font material assume this distance scale
         // x2 to make it more visually equal to our previous generation
         if (font_info.m_OutlineWidth > 0)
-            info->m_Padding += 2.0f * (font_info.m_OutlineWidth + rootOf2);
+            info->m_Spread += 2.0f * (font_info.m_OutlineWidth + rootOf2);
         if (font_info.m_ShadowBlur > 0)
-            info->m_Padding += 2.0f * (font_info.m_ShadowBlur + rootOf2);
-    }
+            info->m_Spread += 2.0f * (font_info.m_ShadowBlur + rootOf2);
 
-    // See Fontc.java. If we have shadow blur, we need 3 channels
-    info->m_HasShadow    = font_info.m_ShadowAlpha > 0.0f && font_info.m_ShadowBlur > 0.0f;
+        // But the image only needs the pixels covered by the outline, and by the blur of the shadow
+        if (font_info.m_OutlineWidth > 0)
+            info->m_Padding += (int)ceilf(font_info.m_OutlineWidth + rootOf2);
+        if (info->m_HasShadow)
+        {
+            info->m_ShadowBlur = dmMath::Min(font_info.m_ShadowBlur, (float)SDF_MAX_BLUR_RADIUS);
+            info->m_Padding += (int)ceilf(info->m_ShadowBlur);
+        }
+    }
 
     info->m_EdgeValue    = ctx->m_DefaultSdfEdge;
+    info->m_SdfAlgorithm = algorithm;
+    info->m_FontSize     = font_info.m_Size;
     info->m_Scale        = dmFontGen::SizeToScale(info->m_TTFResource, font_info.m_Size);
 
     // TODO: Support bitmap fonts
@@ -240,7 +410,7 @@ static FontInfo* LoadFont(Context* ctx, const char* fontc_path, const char* ttf_
 static void DeleteFontInfoIter(Context* ctx, const dmhash_t* hash, FontInfo** infop)
 {
     FontInfo* info = *infop;
-    if (!info->m_Deleted)
+    if (!dmAtomicGet32(&info->m_Deleted))
     {
         dmLogWarning("Font resource wasn't released: %s", dmHashReverseSafe64(*hash));
     }
@@ -249,12 +419,19 @@ static void DeleteFontInfoIter(Context* ctx, const dmhash_t* hash, FontInfo** in
 
 // ****************************************************************************************************
 
+// Shared by the job items of a request. Only accessed on the main thread
 struct JobStatus
 {
-    uint64_t    m_TimeGlyphGen;
-    uint32_t    m_Count;    // Number of job items pushed
-    uint32_t    m_Failures; // Number of failed job items
-    const char* m_Error; // First error sets this string
+    FontInfo*       m_FontInfo; // Kept alive by the pending job items
+    uint32_t        m_RequestId;
+    uint32_t        m_Cancelled; // Set by CancelRequest()
+    uint64_t        m_TimeGlyphGen;
+    uint32_t        m_Count;    // Number of job items the request waits on
+    uint32_t        m_Pending;  // Number of job items not yet post processed
+    uint32_t        m_Failures; // Number of failed job items
+    char            m_Error[256]; // First error sets this string
+    FGlyphCallback  m_Callback;
+    void*           m_CallbackCtx;
 };
 
 struct JobItem
@@ -262,90 +439,246 @@ struct JobItem
     // input
     FontInfo*       m_FontInfo;
     uint32_t        m_Codepoint;
+    Priority        m_Priority;
     //
-    JobStatus*      m_Status;
-    FGlyphCallback  m_Callback;
-    void*           m_CallbackCtx;
-    bool            m_LastItem; // true if it's the last item in the batch
+    JobStatus*      m_Status;   // The request that queued the glyph
+    struct JobWaiter* m_Waiters; // Later requests for the same glyph. Main thread only
+    int32_atomic_t  m_Cancelled; // Set when all the requests waiting on the glyph are cancelled, the workers skip it
     // output
     dmGameSystem::FontGlyph m_Glyph;
     uint8_t*                m_Data;     // May be 0. First byte is the compression (0=no compression, 1=deflate)
     uint32_t                m_DataSize;
+    uint64_t                m_TimeGlyphGen;
+    GlyphSdfJob*            m_SdfJob;   // A glyph being generated over several updates, on platforms without threads
+    uint64_t                m_CacheKey; // The disk cache key of the glyph, or 0 if it's not stored
+    uint32_t                m_ArenaIndex; // The arena holding the m_SdfJob
+    int                     m_SharedPadding;     // If non zero, the distance field is shared with other fonts (see GenerateGlyphSdfShared())
+    float                   m_SharedMaxDistance;
+    uint32_t                m_SharedReserved;    // The bytes reserved in the distance field cache until the item is finished
 };
 
-// Called on the worker thread
-static int JobGenerateGlyph(void* context, void* data)
+// A request waiting on a glyph queued by an earlier request
+struct JobWaiter
 {
-    Context* ctx = (Context*)context;
-    JobItem* item = (JobItem*)data;
-    FontInfo* info = item->m_FontInfo;
-    DM_MUTEX_SCOPED_LOCK(info->m_Mutex);
-    if (!info->m_FontResource)
-        return 0;
+    JobStatus*      m_Status;
+    JobWaiter*      m_Next;
+};
 
-    uint32_t codepoint = item->m_Codepoint;
+// Bump when the image or metrics of the generated glyphs change
+static const uint32_t GLYPH_CACHE_VERSION = 2;
 
-    uint64_t tstart = dmTime::GetTime();
+// Everything that affects the generated glyph
+struct GlyphCacheKey
+{
+    uint64_t    m_DataHash;
+    uint32_t    m_Version;
+    uint32_t    m_FontSize;
+    int32_t     m_Padding;
+    int32_t     m_Spread;
+    float       m_ShadowBlur;
+    int32_t     m_EdgeValue;
+    uint32_t    m_SdfAlgorithm;
+    uint32_t    m_NumChannels;
+    uint32_t    m_GlyphIndex;
+};
 
-    item->m_Data = 0;
-    item->m_DataSize = 0;
-    memset(&item->m_Glyph, 0, sizeof(item->m_Glyph));
+// Stored in front of the image in the disk cache
+struct CachedGlyph
+{
+    float       m_Width;
+    float       m_Height;
+    float       m_ImageWidth;
+    float       m_ImageHeight;
+    float       m_LeftBearing;
+    float       m_Advance;
+    float       m_Ascent;
+    float       m_Descent;
+    uint32_t    m_Channels;
+};
 
-    bool is_whitespace = IsWhiteSpace(codepoint);
+static uint64_t GetGlyphCacheKey(FontInfo* info, uint32_t glyph_index, int num_channels)
+{
+    GlyphCacheKey key;
+    memset(&key, 0, sizeof(key));
+    key.m_DataHash     = dmFontGen::GetFontDataHash(info->m_TTFResource);
+    key.m_Version      = GLYPH_CACHE_VERSION;
+    key.m_FontSize     = info->m_FontSize;
+    key.m_Padding      = info->m_Padding;
+    key.m_Spread       = info->m_Spread;
+    key.m_ShadowBlur   = info->m_HasShadow ? info->m_ShadowBlur : 0.0f;
+    key.m_EdgeValue    = info->m_EdgeValue;
+    key.m_SdfAlgorithm = (uint32_t)info->m_SdfAlgorithm;
+    key.m_NumChannels  = (uint32_t)num_channels;
+    key.m_GlyphIndex   = glyph_index;
+    uint64_t hash = dmHashBuffer64(&key, sizeof(key));
+    return hash ? hash : 1; // 0 means no key
+}
 
-    //
-    TTFResource* ttfresource = info->m_TTFResource;
-    uint32_t glyph_index = dmFontGen::CodePointToGlyphIndex(ttfresource, codepoint);
-    if (!glyph_index)
+// Called on the worker thread
+static bool LoadCachedGlyph(Context* ctx, JobItem* item)
+{
+    uint32_t size = 0;
+    uint8_t* data = DiskCacheGet(ctx->m_DiskCache, item->m_CacheKey, &size);
+    if (!data)
+        return false;
+
+    CachedGlyph cached;
+    if (size < sizeof(cached))
     {
-        if (is_whitespace)
-        {
-            return 1; // We deal with white spaces in the next callback
-        }
-        dmLogError("Codepoint has no glyph index: '%c' 0x%04X", (char)codepoint, codepoint);
-        return 0;
+        free((void*)data);
+        return false;
     }
+    memcpy(&cached, data, sizeof(cached));
 
-    if (info->m_IsSdf)
+    uint32_t data_size = size - sizeof(cached);
+    if (data_size != 1 + (uint32_t)cached.m_ImageWidth * (uint32_t)cached.m_ImageHeight * cached.m_Channels)
     {
-        item->m_Data = dmFontGen::GenerateGlyphSdf(ttfresource, glyph_index, info->m_Scale, info->m_Padding, info->m_EdgeValue, &item->m_Glyph);
-        item->m_DataSize = 1 + item->m_Glyph.m_ImageWidth * item->m_Glyph.m_ImageHeight;
+        free((void*)data);
+        return false;
     }
 
-    if (info->m_HasShadow && item->m_Data)
-    {
-        // Strictly, we can render non-blurred shadow, with a single channel
-        // so this case is about blurred shadow
+    item->m_Glyph.m_Width       = cached.m_Width;
+    item->m_Glyph.m_Height      = cached.m_Height;
+    item->m_Glyph.m_ImageWidth  = cached.m_ImageWidth;
+    item->m_Glyph.m_ImageHeight = cached.m_ImageHeight;
+    item->m_Glyph.m_LeftBearing = cached.m_LeftBearing;
+    item->m_Glyph.m_Advance     = cached.m_Advance;
+    item->m_Glyph.m_Ascent      = cached.m_Ascent;
+    item->m_Glyph.m_Descent     = cached.m_Descent;
+    item->m_Glyph.m_Channels    = cached.m_Channels;
+
+    // The font system frees the image, so it must start at the allocation
+    memmove(data, data + sizeof(cached), data_size);
+    item->m_Data = data;
+    item->m_DataSize = data_size;
+    item->m_CacheKey = 0; // Already stored
+    return true;
+}
 
-// TODO: Blur the blue channel
+// Called on the worker thread
+static void StoreCachedGlyph(Context* ctx, JobItem* item)
+{
+    CachedGlyph cached;
+    cached.m_Width       = item->m_Glyph.m_Width;
+    cached.m_Height      = item->m_Glyph.m_Height;
+    cached.m_ImageWidth  = item->m_Glyph.m_ImageWidth;
+    cached.m_ImageHeight = item->m_Glyph.m_ImageHeight;
+    cached.m_LeftBearing = item->m_Glyph.m_LeftBearing;
+    cached.m_Advance     = item->m_Glyph.m_Advance;
+    cached.m_Ascent      = item->m_Glyph.m_Ascent;
+    cached.m_Descent     = item->m_Glyph.m_Descent;
+    cached.m_Channels    = item->m_Glyph.m_Channels;
+
+    uint32_t size = sizeof(cached) + item->m_DataSize;
+    uint8_t* data = (uint8_t*)malloc(size);
+    memcpy(data, &cached, sizeof(cached));
+    memcpy(data + sizeof(cached), item->m_Data, item->m_DataSize);
+    DiskCachePut(ctx->m_DiskCache, item->m_CacheKey, data, size);
+    free((void*)data);
+}
 
-        // Make a copy
-        item->m_Glyph.m_Channels = 3;
-        uint32_t w = item->m_Glyph.m_ImageWidth;
-        uint32_t h = item->m_Glyph.m_ImageHeight;
-        uint32_t ch = item->m_Glyph.m_Channels;
-        item->m_DataSize = w*h*ch + 1;
+static int GenerateGlyphImage(Context* ctx, FontInfo* info, JobItem* item)
+{
+    uint32_t codepoint = item->m_Codepoint;
+    bool is_whitespace = IsWhiteSpace(codepoint);
 
-        uint8_t* mem = (uint8_t*)malloc(item->m_DataSize);
-        uint8_t* rgb = mem + 1;
+    // Without threads, the job runs within the time budget of the main thread
+    uint64_t deadline = dmJobThread::GetDeadline(ctx->m_Jobs);
 
+    if (!item->m_SdfJob) // Not resuming a glyph from a previous update
+    {
+        item->m_Data = 0;
+        item->m_DataSize = 0;
+        item->m_CacheKey = 0;
+        memset(&item->m_Glyph, 0, sizeof(item->m_Glyph));
 
-        for (int y = 0; y < h; ++y)
+        TTFResource* ttfresource = info->m_TTFResource;
+        uint32_t glyph_index = dmFontGen::CodePointToGlyphIndex(ttfresource, codepoint);
+        if (!glyph_index)
         {
-            for (int x = 0; x < w; ++x)
+            if (is_whitespace)
             {
-                uint8_t value = item->m_Data[1 + y * w + x];
-                rgb[y * (w * ch) + (x * ch) + 0] = value;
-                rgb[y * (w * ch) + (x * ch) + 1] = 0;
-                rgb[y * (w * ch) + (x * ch) + 2] = value;
+                return 1; // We deal with white spaces in the next callback
             }
+            dmLogError("Codepoint has no glyph index: '%c' 0x%04X", (char)codepoint, codepoint);
+            return 0;
         }
-        mem[0] = item->m_Data[0]; // compression
 
-        free((void*)item->m_Data);
-        item->m_Data = mem;
+        if (info->m_IsSdf)
+        {
+            // The shadow is stored in the blue channel, so the final image size is known up front
+            int num_channels = info->m_HasShadow ? 3 : 1;
+
+            if (ctx->m_DiskCache)
+            {
+                item->m_CacheKey = GetGlyphCacheKey(info, glyph_index, num_channels);
+                if (LoadCachedGlyph(ctx, item))
+                    return 1;
+            }
+
+            uint32_t arena_index = 0;
+            Arena* arena = AcquireArena(ctx, &arena_index);
+            if (deadline)
+            {
+                // Generated row by row below, possibly over several updates. The job lives in the arena until it's done
+                item->m_SdfJob = dmFontGen::BeginGlyphSdf(ttfresource, glyph_index, info->m_Scale, info->m_Padding, info->m_Spread, info->m_EdgeValue, info->m_SdfAlgorithm, num_channels, arena);
+                item->m_ArenaIndex = arena ? arena_index : INVALID_ARENA_INDEX;
+                arena = 0;
+            }
+            else
+            {
+                SdfParallelParams parallel;
+                parallel.m_ParallelFor = ParallelFor;
+                parallel.m_Context = ctx;
+                parallel.m_MaxBands = dmJobThread::GetWorkerCount(ctx->m_Jobs) * 2; // Smaller bands balance better between the workers
+                parallel.m_CostThreshold = ctx->m_SdfParallelCost;
+                if (item->m_Priority == PRIORITY_IDLE)
+                    parallel.m_MaxBands = 1; // Idle glyphs must not pull in more workers than the idle throttling allows
+
+                if (item->m_SharedPadding)
+                    item->m_Data = dmFontGen::GenerateGlyphSdfShared(ttfresource, glyph_index, info->m_Scale, info->m_Padding, info->m_Spread, info->m_EdgeValue, item->m_SharedPadding, item->m_SharedMaxDistance, &parallel, num_channels, arena, &item->m_Glyph);
+                else
+                    item->m_Data = dmFontGen::GenerateGlyphSdf(ttfresource, glyph_index, info->m_Scale, info->m_Padding, info->m_Spread, info->m_EdgeValue, info->m_SdfAlgorithm, &parallel, num_channels, arena, &item->m_Glyph);
+            }
+            if (arena)
+                ReleaseArena(ctx, arena_index);
+        }
+    }
+
+    if (item->m_SdfJob)
+    {
+        if (!dmFontGen::StepGlyphSdf(item->m_SdfJob, deadline))
+            return dmJobThread::JOB_RESULT_YIELD;
+        item->m_Data = dmFontGen::EndGlyphSdf(item->m_SdfJob, &item->m_Glyph);
+        item->m_SdfJob = 0;
+        ReleaseArena(ctx, item->m_ArenaIndex);
+    }
+
+    if (item->m_Data)
+    {
+        item->m_DataSize = 1 + item->m_Glyph.m_ImageWidth * item->m_Glyph.m_ImageHeight * item->m_Glyph.m_Channels;
     }
 
+    if (info->m_HasShadow && item->m_Data)
+    {
+        // Strictly, we can render non-blurred shadow, with a single channel
+        // so this case is about blurred shadow.
+        // The face and outline come from the sdf in the red channel, and the shadow is a blur of it in the blue channel
+        uint32_t w = item->m_Glyph.m_ImageWidth;
+        uint32_t h = item->m_Glyph.m_ImageHeight;
+        uint8_t* rgb = item->m_Data + 1;
+        for (uint32_t i = 0; i < w*h; ++i)
+            rgb[i*3 + 1] = 0;
+
+        uint32_t arena_index = INVALID_ARENA_INDEX;
+        Arena* arena = AcquireArena(ctx, &arena_index);
+        SdfBlur(rgb, w, h, 3, 0, 2, info->m_ShadowBlur, arena);
+        ReleaseArena(ctx, arena_index);
+    }
+
+    if (item->m_CacheKey && item->m_Data)
+        StoreCachedGlyph(ctx, item);
+
     if (!item->m_Data) // Some glyphs (e.g. ' ') don't have an image, which is ok
     {
         if (!is_whitespace)
@@ -360,46 +693,183 @@ static int JobGenerateGlyph(void* context, void* data)
         item->m_Glyph.m_ImageHeight = 0;
     }
 
-    uint64_t tend = dmTime::GetTime();
-// TODO: Protect this using a spinlock
-    JobStatus* status = item->m_Status;
-    status->m_TimeGlyphGen += tend - tstart;
-
     return 1;
 }
 
-static void SetFailedStatus(JobItem* item, const char* msg)
+// Called on the worker thread, without holding the lock
+static int JobGenerateGlyph(void* context, void* data)
+{
+    Context* ctx = (Context*)context;
+    JobItem* item = (JobItem*)data;
+    FontInfo* info = item->m_FontInfo;
+
+    // The item holds a reference to the font info, so no lock is needed while generating
+    if (dmAtomicGet32(&info->m_Deleted) || dmAtomicGet32(&item->m_Cancelled))
+    {
+        if (item->m_SdfJob) // Stopped in the middle of a glyph
+        {
+            free((void*)dmFontGen::EndGlyphSdf(item->m_SdfJob, &item->m_Glyph));
+            item->m_SdfJob = 0;
+            ReleaseArena(ctx, item->m_ArenaIndex);
+        }
+        return 0;
+    }
+
+    uint64_t tstart = dmTime::GetTime();
+    int result = GenerateGlyphImage(ctx, info, item);
+    item->m_TimeGlyphGen += dmTime::GetTime() - tstart; // A resumed glyph adds up its time slices
+    return result;
+}
+
+static void SetStatusError(JobStatus* status, const char* msg)
 {
-    JobStatus* status = item->m_Status;
     status->m_Failures++;
-    if (status->m_Error == 0)
+    if (status->m_Error[0] == 0)
     {
-        status->m_Error = strdup(msg);
+        dmStrlCpy(status->m_Error, msg, sizeof(status->m_Error));
     }
+}
+
+static void SetFailedStatus(JobItem* item, const char* msg)
+{
+    SetStatusError(item->m_Status, msg);
+    for (JobWaiter* waiter = item->m_Waiters; waiter; waiter = waiter->m_Next)
+        SetStatusError(waiter->m_Status, msg);
 
     dmLogError("%s", msg); // log for each error in a batch
 }
 
-static void InvokeCallback(JobItem* item)
+static void FinishStatus(Context* ctx, JobStatus* status, bool font_deleted)
 {
-    JobStatus* status = item->m_Status;
-    if (item->m_Callback) // only the last item has this callback
+    ctx->m_Requests.Erase(status->m_RequestId);
+
+    if (status->m_Callback && !font_deleted)
     {
-        item->m_Callback(item->m_CallbackCtx, status->m_Failures == 0, status->m_Error);
+        if (status->m_Cancelled)
+            status->m_Callback(status->m_CallbackCtx, GLYPH_RESULT_CANCELLED, "cancelled");
+        else
+            status->m_Callback(status->m_CallbackCtx, status->m_Failures == 0 ? GLYPH_RESULT_OK : GLYPH_RESULT_ERROR, status->m_Error[0] ? status->m_Error : 0);
 
 // // TODO: Hide this behind a verbosity flag
-// // TODO: Protect this using a spinlock
 //         dmLogInfo("Generated %u glyphs in %.2f ms", status->m_Count, status->m_TimeGlyphGen/1000.0f);
     }
+    ctx->m_StatusPool.Free(status);
+}
+
+// The items may finish in any order, so the callback is invoked when the last one is post processed
+static void FinishItem(Context* ctx, JobItem* item, bool font_deleted)
+{
+    JobStatus* status = item->m_Status;
+    if (status && --status->m_Pending == 0) // A superseded item has no requests left (see SupersedeJob())
+        FinishStatus(ctx, status, font_deleted);
+
+    JobWaiter* waiter = item->m_Waiters;
+    while (waiter)
+    {
+        JobWaiter* next = waiter->m_Next;
+        if (--waiter->m_Status->m_Pending == 0)
+            FinishStatus(ctx, waiter->m_Status, font_deleted);
+        ctx->m_WaiterPool.Free(waiter);
+        waiter = next;
+    }
+
+    if (item->m_SharedReserved)
+        dmFontGen::ReserveDistanceCache(item->m_FontInfo->m_TTFResource, -(int32_t)item->m_SharedReserved);
+    ReleaseFontInfo(ctx, item->m_FontInfo);
+    ctx->m_ItemPool.Free(item);
 }
 
-static void DeleteItem(JobItem* item)
+struct EvictCandidate
+{
+    uint32_t    m_Codepoint;
+    uint32_t    m_LastUse;
+};
+
+static void GatherEvictCandidatesIter(Context* ctx, const uint32_t* codepoint, GlyphEntry* entry)
 {
-    if (item->m_LastItem)
+    // Only the glyphs in the font can be evicted, and the glyphs used this frame are probably on screen
+    if (entry->m_State != GLYPH_STATE_ADDED || entry->m_LastUse == ctx->m_Frame)
+        return;
+    if (ctx->m_EvictCandidates.Full())
+        ctx->m_EvictCandidates.OffsetCapacity(dmMath::Max(64U, ctx->m_EvictCandidates.Capacity()));
+    EvictCandidate candidate = { *codepoint, entry->m_LastUse };
+    ctx->m_EvictCandidates.Push(candidate);
+}
+
+static int CompareEvictCandidates(const void* _a, const void* _b)
+{
+    const EvictCandidate* a = (const EvictCandidate*)_a;
+    const EvictCandidate* b = (const EvictCandidate*)_b;
+    // The frame counter may wrap, so compare the ages
+    return (int32_t)(a->m_LastUse - b->m_LastUse) < 0 ? -1 : (a->m_LastUse == b->m_LastUse ? 0 : 1);
+}
+
+// Removes the least recently used glyphs from the font, until the glyphs use at most max_size bytes,
+// and at least min_count glyphs are removed. The evicted glyphs keep their references, and are generated again when they're used.
+// Returns the number of evicted glyphs
+static uint32_t EvictGlyphs(Context* ctx, FontInfo* info, uint32_t max_size, uint32_t min_count)
+{
+    ctx->m_EvictCandidates.SetSize(0);
+    info->m_Glyphs.Iterate(GatherEvictCandidatesIter, ctx);
+    if (ctx->m_EvictCandidates.Empty())
+        return 0;
+
+    qsort(ctx->m_EvictCandidates.Begin(), ctx->m_EvictCandidates.Size(), sizeof(EvictCandidate), CompareEvictCandidates);
+
+    uint32_t num_evicted = 0;
+    DM_MUTEX_SCOPED_LOCK(info->m_Mutex);
+    for (uint32_t i = 0; i < ctx->m_EvictCandidates.Size(); ++i)
     {
-        delete item->m_Status;
+        if (info->m_GlyphsSize <= max_size && num_evicted >= min_count)
+            break;
+
+        uint32_t codepoint = ctx->m_EvictCandidates[i].m_Codepoint;
+        GlyphEntry* entry = info->m_Glyphs.Get(codepoint);
+        dmGameSystem::ResFontRemoveGlyph(info->m_FontResource, codepoint);
+        info->m_GlyphsSize -= entry->m_Size;
+        entry->m_Size = 0;
+        entry->m_State = GLYPH_STATE_EVICTED;
+        num_evicted++;
     }
-    delete item;
+    ctx->m_GlyphsEvicted += num_evicted;
+    return num_evicted;
+}
+
+static inline void TouchGlyph(Context* ctx, GlyphEntry* entry)
+{
+    entry->m_LastUse = ctx->m_Frame;
+}
+
+// Marks the glyph as added to the font, or forgets it so it can be requested again.
+// The table may already refer to a newer job for the same codepoint, if this one was cancelled or superseded
+static void SetGlyphAdded(Context* ctx, FontInfo* info, JobItem* item, bool added)
+{
+    GlyphEntry* entry = info->m_Glyphs.Get(item->m_Codepoint);
+    if (!entry || entry->m_Job != item)
+        return;
+    entry->m_Job = 0;
+    if (added)
+    {
+        entry->m_State = GLYPH_STATE_ADDED;
+        entry->m_Size = item->m_DataSize;
+        info->m_GlyphsSize += entry->m_Size;
+        TouchGlyph(ctx, entry);
+    }
+    else if (entry->m_RefCount > 0)
+    {
+        entry->m_State = GLYPH_STATE_MISSING; // The requests still hold their references (see RemoveGlyphs())
+    }
+    else
+    {
+        info->m_Glyphs.Erase(item->m_Codepoint);
+    }
+}
+
+// False if all the references were removed while the glyph was generated
+static bool IsGlyphWanted(FontInfo* info, uint32_t codepoint)
+{
+    GlyphEntry* entry = info->m_Glyphs.Get(codepoint);
+    return entry && entry->m_RefCount > 0;
 }
 
 // Called on the main thread
@@ -409,28 +879,67 @@ static void JobPostProcessGlyph(void* context, void* data, int result)
     JobItem* item = (JobItem*)data;
     FontInfo* info = item->m_FontInfo;
 
-    DM_MUTEX_SCOPED_LOCK(info->m_Mutex);
-    if (!info->m_FontResource)
+    if (dmAtomicGet32(&info->m_Deleted))
     {
-        DeleteItem(item);
+        free((void*)item->m_Data);
+        FinishItem(ctx, item, true);
+        return;
+    }
+
+    if (dmAtomicGet32(&item->m_Cancelled)) // Either removed from the queue, or skipped by the worker
+    {
+        SetGlyphAdded(ctx, info, item, false);
+        free((void*)item->m_Data);
+        FinishItem(ctx, item, false);
         return;
     }
 
-    JobStatus* status = item->m_Status;
     uint32_t codepoint = item->m_Codepoint;
+    item->m_Status->m_TimeGlyphGen += item->m_TimeGlyphGen;
 
     if (!result)
     {
         char msg[256];
         dmSnPrintf(msg, sizeof(msg), "Failed to generate glyph '%c' 0x%04X", codepoint, codepoint);
         SetFailedStatus(item, msg);
-        InvokeCallback(item);
-        DeleteItem(item);
+        SetGlyphAdded(ctx, info, item, false);
+        free((void*)item->m_Data);
+        FinishItem(ctx, item, false);
         return;
     }
 
-    // The font system takes ownership of the image data
-    dmResource::Result r = dmGameSystem::ResFontAddGlyph(info->m_FontResource, codepoint, &item->m_Glyph, item->m_Data, item->m_DataSize);
+    if (!IsGlyphWanted(info, codepoint))
+    {
+        SetGlyphAdded(ctx, info, item, false);
+        free((void*)item->m_Data);
+        FinishItem(ctx, item, false);
+        return;
+    }
+
+    uint32_t budget = ctx->m_GlyphBudget;
+    if (budget && info->m_GlyphsSize + item->m_DataSize > budget)
+    {
+        // Make some extra room, so the glyphs aren't evicted one at a time
+        EvictGlyphs(ctx, info, budget - dmMath::Min(budget, item->m_DataSize + budget / 8), 0);
+    }
+
+    dmResource::Result r;
+    {
+        // The font system takes ownership of the image data
+        DM_MUTEX_SCOPED_LOCK(info->m_Mutex);
+        r = dmGameSystem::ResFontAddGlyph(info->m_FontResource, codepoint, &item->m_Glyph, item->m_Data, item->m_DataSize);
+    }
+
+    if (dmResource::RESULT_OUT_OF_RESOURCES == r)
+    {
+        // The font is full, retry once after evicting an eighth of the glyphs
+        uint32_t num_evict = dmMath::Max(1U, info->m_Glyphs.Size() / 8);
+        if (EvictGlyphs(ctx, info, info->m_GlyphsSize, num_evict))
+        {
+            DM_MUTEX_SCOPED_LOCK(info->m_Mutex);
+            r = dmGameSystem::ResFontAddGlyph(info->m_FontResource, codepoint, &item->m_Glyph, item->m_Data, item->m_DataSize);
+        }
+    }
 
     if (dmResource::RESULT_OK != r)
     {
@@ -438,63 +947,404 @@ static void JobPostProcessGlyph(void* context, void* data, int result)
         dmSnPrintf(msg, sizeof(msg), "Failed to add glyph '%c': result: %d", codepoint, r);
         SetFailedStatus(item, msg);
     }
+    SetGlyphAdded(ctx, info, item, dmResource::RESULT_OK == r);
 
-    InvokeCallback(item); // reports either first error, or success
-    DeleteItem(item);
+    FinishItem(ctx, item, false); // reports either first error, or success
 }
 
 // ****************************************************************************************************
 
-static void GenerateGlyph(Context* ctx, FontInfo* info, uint32_t codepoint, bool last_item, JobStatus* status, FGlyphCallback cbk, void* cbk_ctx)
+static JobItem* CreateJobItem(Context* ctx, FontInfo* info, uint32_t codepoint, Priority priority, JobStatus* status)
 {
-    JobItem* item = new JobItem;
+    JobItem* item = ctx->m_ItemPool.Alloc();
     item->m_FontInfo = info;
     item->m_Codepoint = codepoint;
-    item->m_Callback = cbk;
-    item->m_CallbackCtx = cbk_ctx;
+    item->m_Priority = priority;
     item->m_Status = status;
-    item->m_LastItem = last_item;
-    dmJobThread::PushJob(ctx->m_Jobs, JobGenerateGlyph, JobPostProcessGlyph, ctx, item);
+    item->m_Waiters = 0;
+    item->m_Cancelled = 0;
+    item->m_Data = 0;
+    item->m_DataSize = 0;
+    item->m_TimeGlyphGen = 0;
+    item->m_SdfJob = 0;
+    item->m_CacheKey = 0;
+    item->m_SharedPadding = 0;
+    item->m_SharedMaxDistance = 0.0f;
+    item->m_SharedReserved = 0;
+    AcquireFontInfo(info);
+    return item;
+}
+
+// Keep the glyphs of a font on the same worker.
+// Fonts with the same ttf and size share their distance fields, so they also share the worker that caches them
+static uint32_t GetJobAffinity(FontInfo* info)
+{
+    uint32_t key[2] = { (uint32_t)(uintptr_t)info->m_TTFResource, 0 };
+    memcpy(&key[1], &info->m_Scale, sizeof(float));
+    return dmHashBuffer32(key, sizeof(key)) & 0x7FFFFFFF;
 }
 
-static void GenerateGlyphs(Context* ctx, FontInfo* info, const char* text, FGlyphCallback cbk, void* cbk_ctx)
+static bool CanShareDistanceField(FontInfo* info)
 {
-    uint32_t len        = dmUtf8::StrLen(text);
+    return info->m_IsSdf && info->m_SdfAlgorithm == SDF_ALGORITHM_ANALYTIC;
+}
+
+struct SharedSdfContext
+{
+    FontInfo*   m_FontInfo;
+    int         m_Padding;
+    float       m_MaxDistance;
+    uint32_t    m_NumFonts;
+};
+
+static void GetSharedSdfIter(SharedSdfContext* shared, const dmhash_t* key, FontInfo** pinfo)
+{
+    FontInfo* info = *pinfo;
+    FontInfo* target = shared->m_FontInfo;
+    if (info == target || info->m_TTFResource != target->m_TTFResource || info->m_Scale != target->m_Scale || !CanShareDistanceField(info))
+        return;
+    shared->m_Padding = dmMath::Max(shared->m_Padding, info->m_Padding);
+    shared->m_MaxDistance = dmMath::Max(shared->m_MaxDistance, SdfGetMaxDistance(info->m_EdgeValue, info->m_EdgeValue / (float)info->m_Spread));
+    shared->m_NumFonts++;
+}
+
+// Gets the padding and max distance of a distance field that serves all the loaded fonts with the same ttf and size.
+// Returns false if no other font uses the same field
+static bool GetSharedSdfParams(Context* ctx, FontInfo* info, int* padding, float* max_distance)
+{
+    if (!CanShareDistanceField(info))
+        return false;
+
+    SharedSdfContext shared;
+    shared.m_FontInfo = info;
+    shared.m_Padding = info->m_Padding;
+    shared.m_MaxDistance = SdfGetMaxDistance(info->m_EdgeValue, info->m_EdgeValue / (float)info->m_Spread);
+    shared.m_NumFonts = 0;
+    ctx->m_FontInfos.Iterate(GetSharedSdfIter, &shared);
+    if (!shared.m_NumFonts)
+        return false;
 
-    JobStatus* status      = new JobStatus;
+    *padding = shared.m_Padding;
+    *max_distance = shared.m_MaxDistance;
+    return true;
+}
+
+// Called on the main thread
+static bool IsWaitingOn(JobItem* item, JobStatus* status)
+{
+    if (item->m_Status == status)
+        return true;
+    for (JobWaiter* waiter = item->m_Waiters; waiter; waiter = waiter->m_Next)
+    {
+        if (waiter->m_Status == status)
+            return true;
+    }
+    return false;
+}
+
+static bool IsAllCancelled(JobItem* item)
+{
+    if (!item->m_Status->m_Cancelled)
+        return false;
+    for (JobWaiter* waiter = item->m_Waiters; waiter; waiter = waiter->m_Next)
+    {
+        if (!waiter->m_Status->m_Cancelled)
+            return false;
+    }
+    return true;
+}
+
+static void AddWaiter(Context* ctx, JobItem* item, JobStatus* status)
+{
+    JobWaiter* waiter = ctx->m_WaiterPool.Alloc();
+    waiter->m_Status = status;
+    waiter->m_Next = item->m_Waiters;
+    item->m_Waiters = waiter;
+}
+
+static bool MatchCancelledItem(void* context, void* data)
+{
+    return dmAtomicGet32(&((JobItem*)data)->m_Cancelled) != 0;
+}
+
+// Moves the requests of a queued job to a more urgent job for the same glyph, and cancels the old job.
+// The glyph entry only ever refers to one job, so the glyph is generated and added once
+static void SupersedeJob(Context* ctx, JobItem* old_item, JobItem* item)
+{
+    AddWaiter(ctx, item, old_item->m_Status);
+    JobWaiter* waiter = old_item->m_Waiters;
+    while (waiter)
+    {
+        JobWaiter* next = waiter->m_Next;
+        waiter->m_Next = item->m_Waiters;
+        item->m_Waiters = waiter;
+        waiter = next;
+    }
+    old_item->m_Status = 0;
+    old_item->m_Waiters = 0;
+
+    // Removed from the queue below, or skipped by the worker. It's finished in the next Update() without any requests
+    dmAtomicStore32(&old_item->m_Cancelled, 1);
+}
+
+static void PutQueuedGlyph(FontInfo* info, JobItem* item, uint32_t serial)
+{
+    if (info->m_Glyphs.Full())
+    {
+        uint32_t cap = info->m_Glyphs.Capacity() + 64;
+        info->m_Glyphs.SetCapacity((cap*2)/3, cap);
+    }
+    GlyphEntry entry;
+    entry.m_Job = item;
+    entry.m_State = GLYPH_STATE_QUEUED;
+    entry.m_RefCount = 1;
+    entry.m_Serial = serial;
+    entry.m_LastUse = 0;
+    entry.m_Size = 0;
+    info->m_Glyphs.Put(item->m_Codepoint, entry);
+}
+
+static JobStatus* CreateStatus(Context* ctx, FontInfo* info, FGlyphCallback cbk, void* cbk_ctx)
+{
+    uint32_t request_id = ctx->m_NextRequestId++;
+    if (ctx->m_NextRequestId == 0)
+        ctx->m_NextRequestId = 1; // 0 is never a valid request id
+
+    JobStatus* status      = ctx->m_StatusPool.Alloc();
+    status->m_FontInfo     = info;
+    status->m_RequestId    = request_id;
+    status->m_Cancelled    = 0;
     status->m_TimeGlyphGen = 0;
-    status->m_Count        = len;
+    status->m_Count        = 0;
+    status->m_Pending      = 0;
     status->m_Failures     = 0;
-    status->m_Error        = 0;
+    status->m_Error[0]     = 0;
+    status->m_Callback     = cbk;
+    status->m_CallbackCtx  = cbk_ctx;
+
+    if (ctx->m_Requests.Full())
+    {
+        uint32_t cap = ctx->m_Requests.Capacity() + 32;
+        ctx->m_Requests.SetCapacity((cap*2)/3, cap);
+    }
+    ctx->m_Requests.Put(request_id, status);
+    return status;
+}
+
+// Queues the glyph of an entry that isn't in the font, or queued
+static JobItem* RequeueGlyph(Context* ctx, FontInfo* info, GlyphEntry* entry, uint32_t codepoint, Priority priority, JobStatus* status)
+{
+    JobItem* item = CreateJobItem(ctx, info, codepoint, priority, status);
+    entry->m_Job = item;
+    entry->m_State = GLYPH_STATE_QUEUED;
+    status->m_Pending++;
+    return item;
+}
+
+static void PushGlyphJobs(Context* ctx, FontInfo* info, dmArray<void*>& items, Priority priority)
+{
+    int shared_padding = 0;
+    float shared_max_distance = 0.0f;
+    if (GetSharedSdfParams(ctx, info, &shared_padding, &shared_max_distance))
+    {
+        // The jobs of the fonts in the group run one font after the other, so the cache keeps the fields
+        // of the whole batch until the jobs of the other fonts have used them
+        uint32_t reserved = 0;
+        for (uint32_t i = 0; i < items.Size(); ++i)
+        {
+            JobItem* item = (JobItem*)items[i];
+            item->m_SharedPadding = shared_padding;
+            item->m_SharedMaxDistance = shared_max_distance;
+            uint32_t glyph_index = dmFontGen::CodePointToGlyphIndex(info->m_TTFResource, item->m_Codepoint);
+            item->m_SharedReserved = dmFontGen::GetGlyphDistanceFieldSize(info->m_TTFResource, glyph_index, info->m_Scale, shared_padding);
+            reserved += item->m_SharedReserved;
+        }
+        dmFontGen::ReserveDistanceCache(info->m_TTFResource, (int32_t)reserved);
+    }
+
+    dmJobThread::PushJobs(ctx->m_Jobs, JobGenerateGlyph, JobPostProcessGlyph, ctx, items.Begin(), items.Size(), GetJobAffinity(info), (dmJobThread::JobPriority)priority);
+}
+
+// Only the glyphs not already added or queued are generated. A request for a queued glyph waits on the existing job.
+// Each glyph in the text gets a reference, which is released by RemoveGlyphs()
+static uint32_t GenerateGlyphs(Context* ctx, FontInfo* info, const char* text, Priority priority, FGlyphCallback cbk, void* cbk_ctx)
+{
+    uint32_t len = dmUtf8::StrLen(text);
+    JobStatus* status = CreateStatus(ctx, info, cbk, cbk_ctx);
+
+    dmArray<void*>& items = ctx->m_PushItems;
+    items.SetSize(0);
+    if (items.Capacity() < len)
+        items.SetCapacity(len);
 
+    uint32_t serial = ++ctx->m_GlyphSerial;
+    uint32_t num_superseded = 0;
     const char* cursor = text;
     uint32_t c = 0;
-    uint32_t index  = 0;
     while ((c = dmUtf8::NextChar(&cursor)))
     {
-        ++index;
-        bool last_item = len == index;
+        GlyphEntry* entry = info->m_Glyphs.Get(c);
+        if (!entry)
+        {
+            JobItem* item = CreateJobItem(ctx, info, c, priority, status);
+            PutQueuedGlyph(info, item, serial);
+            items.Push(item);
+            status->m_Pending++;
+            continue;
+        }
+
+        if (entry->m_Serial == serial)
+            continue; // Repeated in the text
+        entry->m_Serial = serial;
+        entry->m_RefCount++;
+        TouchGlyph(ctx, entry);
+
+        if (entry->m_State == GLYPH_STATE_ADDED)
+            continue;
+        if (entry->m_State != GLYPH_STATE_QUEUED) // Evicted, cancelled or failed
+        {
+            items.Push(RequeueGlyph(ctx, info, entry, c, priority, status));
+            continue;
+        }
+
+        JobItem* queued = entry->m_Job;
+
+        if (!dmAtomicGet32(&queued->m_Cancelled) && queued->m_Priority <= priority)
+        {
+            AddWaiter(ctx, queued, status);
+            status->m_Pending++;
+            continue;
+        }
 
-        FGlyphCallback last_callback = 0;
-        void*          last_callback_ctx = 0;
-        if (last_item)
+        // A cancelled job is replaced by a new one. So is a less urgent one, as the request shouldn't wait on it.
+        // The requests waiting on the less urgent job then wait on the new one instead
+        JobItem* item = CreateJobItem(ctx, info, c, priority, status);
+        if (!dmAtomicGet32(&queued->m_Cancelled))
         {
-            last_callback = cbk;
-            last_callback_ctx = cbk_ctx;
+            SupersedeJob(ctx, queued, item);
+            num_superseded++;
         }
-        GenerateGlyph(ctx, info, c, last_item, status, last_callback, last_callback_ctx);
+        entry->m_Job = item;
+        items.Push(item);
+        status->m_Pending++;
+    }
+    status->m_Count = status->m_Pending;
+
+    if (!status->m_Pending)
+    {
+        // The callback is never called from within AddGlyphs()
+        if (ctx->m_FinishedRequests.Full())
+            ctx->m_FinishedRequests.OffsetCapacity(16);
+        ctx->m_FinishedRequests.Push(status);
+        return status->m_RequestId;
     }
+
+    if (num_superseded)
+        dmJobThread::CancelJobs(ctx->m_Jobs, MatchCancelledItem, 0);
+
+    if (!items.Empty())
+        PushGlyphJobs(ctx, info, items, priority);
+    return status->m_RequestId;
 }
 
-static void RemoveGlyphs(FontInfo* info, const char* text)
+static void CancelQueuedGlyphIter(JobStatus* status, const uint32_t* codepoint, GlyphEntry* entry)
+{
+    JobItem* item = entry->m_Job;
+    if (!item || !IsWaitingOn(item, status))
+        return;
+    // A glyph shared with another request is still generated
+    if (IsAllCancelled(item))
+        dmAtomicStore32(&item->m_Cancelled, 1);
+}
+
+static bool CancelRequest(Context* ctx, uint32_t request_id)
+{
+    JobStatus** pstatus = ctx->m_Requests.Get(request_id);
+    if (!pstatus)
+        return false; // Already finished, or never existed
+
+    JobStatus* status = *pstatus;
+    if (status->m_Cancelled)
+        return true; // Already cancelled
+    status->m_Cancelled = 1;
+
+    if (!status->m_Pending)
+        return true; // Nothing queued, the callback is called in the next Update()
+
+    // The queued items are removed right away, the ones already picked up by a worker are skipped.
+    // In both cases they're finished in the next Update(), which calls the callback once
+    status->m_FontInfo->m_Glyphs.Iterate(CancelQueuedGlyphIter, status);
+    dmJobThread::CancelJobs(ctx->m_Jobs, MatchCancelledItem, 0);
+    return true;
+}
+
+// Releases a reference to each glyph in the text. A glyph is removed from the font when it has no references left
+static void RemoveGlyphs(Context* ctx, FontInfo* info, const char* text)
 {
     const char* cursor = text;
     uint32_t c = 0;
 
-    uint32_t num_added = 0;
+    uint32_t serial = ++ctx->m_GlyphSerial;
+    DM_MUTEX_SCOPED_LOCK(info->m_Mutex);
     while ((c = dmUtf8::NextChar(&cursor)))
     {
-        dmGameSystem::ResFontRemoveGlyph(info->m_FontResource, c);
+        GlyphEntry* entry = info->m_Glyphs.Get(c);
+        if (!entry)
+        {
+            // Not added by fontgen (e.g. part of the .fontc)
+            dmGameSystem::ResFontRemoveGlyph(info->m_FontResource, c);
+            continue;
+        }
+
+        if (entry->m_Serial == serial)
+            continue; // Repeated in the text
+        entry->m_Serial = serial;
+        if (entry->m_RefCount > 0)
+            entry->m_RefCount--;
+        if (entry->m_RefCount > 0)
+            continue;
+
+        // A queued glyph is dropped when it's done, unless it's requested again before that
+        if (entry->m_State == GLYPH_STATE_QUEUED)
+            continue;
+        if (entry->m_State == GLYPH_STATE_ADDED)
+        {
+            dmGameSystem::ResFontRemoveGlyph(info->m_FontResource, c);
+            info->m_GlyphsSize -= entry->m_Size;
+        }
+        info->m_Glyphs.Erase(c);
+    }
+}
+
+// The evicted glyphs in the text are queued again, without a callback
+static void TouchGlyphs(Context* ctx, FontInfo* info, const char* text)
+{
+    JobStatus* status = 0;
+    dmArray<void*>& items = ctx->m_PushItems;
+    items.SetSize(0);
+
+    const char* cursor = text;
+    uint32_t c = 0;
+    while ((c = dmUtf8::NextChar(&cursor)))
+    {
+        GlyphEntry* entry = info->m_Glyphs.Get(c);
+        if (!entry)
+            continue;
+        TouchGlyph(ctx, entry);
+        if (entry->m_State != GLYPH_STATE_EVICTED)
+            continue;
+
+        if (!status)
+            status = CreateStatus(ctx, info, 0, 0);
+        if (items.Full())
+            items.OffsetCapacity(dmMath::Max(16U, items.Capacity()));
+        items.Push(RequeueGlyph(ctx, info, entry, c, PRIORITY_NORMAL, status));
+    }
+
+    if (status)
+    {
+        status->m_Count = status->m_Pending;
+        PushGlyphJobs(ctx, info, items, PRIORITY_NORMAL);
     }
 }
 
@@ -502,16 +1352,63 @@ bool Initialize(dmExtension::Params* params)
 {
     g_FontExtContext = new Context;
     g_FontExtContext->m_ResourceFactory = params->m_ResourceFactory;
-    g_FontExtContext->m_Mutex = dmMutex::New();
+    g_FontExtContext->m_NextRequestId = 1;
+    g_FontExtContext->m_GlyphSerial = 0;
+    g_FontExtContext->m_Frame = 0;
+    g_FontExtContext->m_GlyphsEvicted = 0;
+    g_FontExtContext->m_UpdateDeferredFrames = 0;
+    g_FontExtContext->m_UpdateDeferredGlyphs = 0;
+    g_FontExtContext->m_UpdateMaxDeferred = 0;
 
     // 3 is arbitrary but resembles the output from out generator
     g_FontExtContext->m_DefaultSdfPadding = dmConfigFile::GetInt(params->m_ConfigFile, "fontgen.sdf_base_padding", 3);
     g_FontExtContext->m_DefaultSdfEdge = dmConfigFile::GetInt(params->m_ConfigFile, "fontgen.sdf_edge_value", 190);
 
+    const char* sdf_algorithm = dmConfigFile::GetString(params->m_ConfigFile, "fontgen.sdf_algorithm", "analytic");
+    if (!GetSdfAlgorithm(sdf_algorithm, &g_FontExtContext->m_DefaultSdfAlgorithm))
+    {
+        dmLogWarning("Unknown fontgen.sdf_algorithm '%s', using 'analytic'", sdf_algorithm);
+        g_FontExtContext->m_DefaultSdfAlgorithm = SDF_ALGORITHM_ANALYTIC;
+    }
+    g_FontExtContext->m_SdfParallelCost = dmConfigFile::GetInt(params->m_ConfigFile, "fontgen.sdf_parallel_cost", 250000);
+    SetOutlineCacheSize(dmConfigFile::GetInt(params->m_ConfigFile, "fontgen.outline_cache_size", 1024) * 1024);
+    SetDistanceCacheSize(dmConfigFile::GetInt(params->m_ConfigFile, "fontgen.distance_cache_size", 2048) * 1024);
+    g_FontExtContext->m_UpdateBudget = (uint32_t)dmMath::Max(0, dmConfigFile::GetInt(params->m_ConfigFile, "fontgen.update_budget", 1000));
+    g_FontExtContext->m_GlyphBudget = (uint32_t)dmMath::Max(0, dmConfigFile::GetInt(params->m_ConfigFile, "fontgen.glyph_budget", 0)) * 1024;
+
     dmJobThread::JobThreadCreationParams job_thread_create_param;
-    job_thread_create_param.m_ThreadNames[0] = "FontGenJobThread";
-    job_thread_create_param.m_ThreadCount    = 1;
+    const char* worker_threads = dmConfigFile::GetString(params->m_ConfigFile, "fontgen.worker_threads", "auto");
+    job_thread_create_param.m_ThreadCount    = GetWorkerThreadCount(worker_threads);
+    for (uint32_t i = 0; i < job_thread_create_param.m_ThreadCount; ++i)
+        job_thread_create_param.m_ThreadNames[i] = "FontGenJobThread";
     g_FontExtContext->m_Jobs = dmJobThread::Create(job_thread_create_param);
+
+    g_FontExtContext->m_DiskCache = 0;
+    uint32_t disk_cache_size = (uint32_t)dmMath::Max(0, dmConfigFile::GetInt(params->m_ConfigFile, "fontgen.disk_cache_size", 0)) * 1024;
+    if (disk_cache_size)
+    {
+        const char* title = dmConfigFile::GetString(params->m_ConfigFile, "project.title", "defold");
+        char path[1024];
+        if (dmSys::RESULT_OK == dmSys::GetApplicationSupportPath(title, path, sizeof(path)))
+        {
+            dmStrlCat(path, "/fontgen.cache", sizeof(path));
+            g_FontExtContext->m_DiskCache = DiskCacheOpen(path, disk_cache_size);
+        }
+        else
+        {
+            dmLogWarning("Failed to get the application support path, the glyph disk cache is disabled");
+        }
+    }
+
+    // Non threaded builds run the jobs on the main thread
+    uint32_t num_arenas = dmMath::Max(1U, dmJobThread::GetWorkerCount(g_FontExtContext->m_Jobs));
+    g_FontExtContext->m_Arenas.SetCapacity(num_arenas);
+    g_FontExtContext->m_ArenasInUse = new int32_atomic_t[num_arenas];
+    for (uint32_t i = 0; i < num_arenas; ++i)
+    {
+        g_FontExtContext->m_Arenas.Push(ArenaCreate(ARENA_INITIAL_SIZE));
+        g_FontExtContext->m_ArenasInUse[i] = 0;
+    }
     return true;
 }
 
@@ -519,16 +1416,23 @@ void Finalize(dmExtension::Params* params)
 {
     Context* ctx = g_FontExtContext;
 
+    // Wait for the workers to finish, before deleting the fonts
+    if (ctx->m_Jobs)
+        dmJobThread::Destroy(ctx->m_Jobs);
+
     ctx->m_FontInfos.Iterate(DeleteFontInfoIter, ctx);
     ctx->m_FontInfos.Clear();
 
-    ctx->m_DeletedFontInfos.Iterate(DeleteFontInfoIter, ctx);
-    ctx->m_DeletedFontInfos.Clear();
+    for (uint32_t i = 0; i < ctx->m_DeletedFontInfos.Size(); ++i)
+        DeleteFont(ctx, ctx->m_DeletedFontInfos[i]);
+    ctx->m_DeletedFontInfos.SetSize(0);
 
-    if (ctx->m_Jobs)
-        dmJobThread::Destroy(ctx->m_Jobs);
+    for (uint32_t i = 0; i < ctx->m_Arenas.Size(); ++i)
+        ArenaDelete(ctx->m_Arenas[i]);
+    delete[] ctx->m_ArenasInUse;
 
-    dmMutex::Delete(ctx->m_Mutex);
+    if (ctx->m_DiskCache)
+        DiskCacheClose(ctx->m_DiskCache);
 
     delete ctx;
     ctx = 0;
@@ -537,16 +1441,34 @@ void Finalize(dmExtension::Params* params)
 
 void Update(dmExtension::Params* params)
 {
-    if (g_FontExtContext->m_Jobs)
-        dmJobThread::Update(g_FontExtContext->m_Jobs, 1000); // Update for max 1 millisecond on non-threaded systems
+    Context* ctx = g_FontExtContext;
+    if (!ctx->m_Jobs)
+        return;
+
+    ctx->m_Frame++;
+
+    // Requests that had all their glyphs already. A callback may add more requests, they're handled in the next Update()
+    uint32_t num_finished = ctx->m_FinishedRequests.Size();
+    for (uint32_t i = 0; i < num_finished; ++i)
+        FinishStatus(ctx, ctx->m_FinishedRequests[i], false);
+    uint32_t num_remaining = ctx->m_FinishedRequests.Size() - num_finished;
+    if (num_remaining)
+        memmove(ctx->m_FinishedRequests.Begin(), ctx->m_FinishedRequests.Begin() + num_finished, num_remaining * sizeof(JobStatus*));
+    ctx->m_FinishedRequests.SetSize(num_remaining);
 
-    g_FontExtContext->m_DeletedFontInfos.Iterate(DeleteFontInfoIter, g_FontExtContext);
-    g_FontExtContext->m_DeletedFontInfos.Clear();
+    // Adding the glyphs to the font may upload textures, so a large request is spread over several frames
+    uint32_t num_deferred = dmJobThread::Update(ctx->m_Jobs, ctx->m_UpdateBudget);
+    if (num_deferred)
+    {
+        ctx->m_UpdateDeferredFrames++;
+        ctx->m_UpdateDeferredGlyphs += num_deferred;
+        ctx->m_UpdateMaxDeferred = dmMath::Max(ctx->m_UpdateMaxDeferred, num_deferred);
+    }
 }
 
 // Scripting
 
-bool LoadFont(const char* fontc_path, const char* ttf_path)
+bool LoadFont(const char* fontc_path, const char* ttf_path, const char* sdf_algorithm)
 {
     Context* ctx = g_FontExtContext;
     FontInfo** pinfo = ctx->m_FontInfos.Get(dmHashString64(fontc_path));
@@ -556,7 +1478,7 @@ bool LoadFont(const char* fontc_path, const char* ttf_path)
         return false; // Already loaded
     }
 
-    FontInfo* info = LoadFont(ctx, fontc_path, ttf_path);
+    FontInfo* info = LoadFont(ctx, fontc_path, ttf_path, sdf_algorithm);
     return info != 0;
 }
 
@@ -567,20 +1489,24 @@ bool UnloadFont(dmhash_t fontc_path_hash)
 }
 
 
-bool AddGlyphs(dmhash_t fontc_path_hash, const char* text, FGlyphCallback cbk, void* cbk_ctx)
+uint32_t AddGlyphs(dmhash_t fontc_path_hash, const char* text, Priority priority, FGlyphCallback cbk, void* cbk_ctx)
 {
     Context* ctx = g_FontExtContext;
     FontInfo** pinfo = ctx->m_FontInfos.Get(fontc_path_hash);
     if (!pinfo)
     {
         dmLogError("Font not loaded %s", dmHashReverseSafe64(fontc_path_hash));
-        return false;
+        return 0;
     }
 
-    GenerateGlyphs(ctx, *pinfo, text, cbk, cbk_ctx);
-
     //dmGameSystem::ResFontDebugPrint((*pinfo)->m_FontResource);
-    return true;
+    return GenerateGlyphs(ctx, *pinfo, text, priority, cbk, cbk_ctx);
+}
+
+bool Cancel(uint32_t request_id)
+{
+    Context* ctx = g_FontExtContext;
+    return CancelRequest(ctx, request_id);
 }
 
 
@@ -594,12 +1520,73 @@ bool RemoveGlyphs(dmhash_t fontc_path_hash, const char* text)
         return false;
     }
 
-    RemoveGlyphs(*pinfo, text);
+    RemoveGlyphs(ctx, *pinfo, text);
 
     //dmGameSystem::ResFontDebugPrint((*pinfo)->m_FontResource);
     return true;
 }
 
+bool TouchGlyphs(dmhash_t fontc_path_hash, const char* text)
+{
+    Context* ctx = g_FontExtContext;
+    FontInfo** pinfo = ctx->m_FontInfos.Get(fontc_path_hash);
+    if (!pinfo)
+    {
+        dmLogError("Font not loaded %s", dmHashReverseSafe64(fontc_path_hash));
+        return false;
+    }
+
+    TouchGlyphs(ctx, *pinfo, text);
+    return true;
+}
+
+struct GetStatsContext
+{
+    Stats*                  m_Stats;
+    dmArray<TTFResource*>   m_Visited; // Several fonts may share the same ttf
+};
+
+static void GetStatsIter(GetStatsContext* ctx, const dmhash_t* hash, FontInfo** pinfo)
+{
+    TTFResource* ttfresource = (*pinfo)->m_TTFResource;
+    for (uint32_t i = 0; i < ctx->m_Visited.Size(); ++i)
+    {
+        if (ctx->m_Visited[i] == ttfresource)
+            return;
+    }
+    if (ctx->m_Visited.Full())
+        ctx->m_Visited.OffsetCapacity(8);
+    ctx->m_Visited.Push(ttfresource);
+
+    uint32_t hits, misses;
+    GetOutlineCacheStats(ttfresource, &hits, &misses);
+    ctx->m_Stats->m_OutlineCacheHits += hits;
+    ctx->m_Stats->m_OutlineCacheMisses += misses;
+
+    GetDistanceCacheStats(ttfresource, &hits, &misses);
+    ctx->m_Stats->m_DistanceCacheHits += hits;
+    ctx->m_Stats->m_DistanceCacheMisses += misses;
+}
+
+void GetStats(Stats* stats)
+{
+    Context* ctx = g_FontExtContext;
+    memset(stats, 0, sizeof(*stats));
+    for (uint32_t i = 0; i < ctx->m_Arenas.Size(); ++i)
+        stats->m_ArenaHighWater = dmMath::Max(stats->m_ArenaHighWater, ArenaGetHighWater(ctx->m_Arenas[i]));
+
+    GetStatsContext stats_ctx;
+    stats_ctx.m_Stats = stats;
+    ctx->m_FontInfos.Iterate(GetStatsIter, &stats_ctx);
+
+    stats->m_UpdateDeferredFrames = ctx->m_UpdateDeferredFrames;
+    stats->m_UpdateDeferredGlyphs = ctx->m_UpdateDeferredGlyphs;
+    stats->m_UpdateMaxDeferred = ctx->m_UpdateMaxDeferred;
+    stats->m_GlyphsEvicted = ctx->m_GlyphsEvicted;
+    if (ctx->m_DiskCache)
+        DiskCacheGetStats(ctx->m_DiskCache, &stats->m_DiskCacheHits, &stats->m_DiskCacheMisses);
+}
+
 
 
 } // namespace
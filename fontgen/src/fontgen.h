@@ -11,11 +11,51 @@ namespace dmFontGen
 
     // Scripting
 
-    bool LoadFont(const char* fontc_path, const char* ttf_path);
+    // sdf_algorithm is "analytic", "raster", "msdf" or 0 (uses fontgen.sdf_algorithm)
+    bool LoadFont(const char* fontc_path, const char* ttf_path, const char* sdf_algorithm);
     bool UnloadFont(dmhash_t fontc_path_hash);
 
+    enum GlyphResult
+    {
+        GLYPH_RESULT_ERROR      = 0,
+        GLYPH_RESULT_OK         = 1,
+        GLYPH_RESULT_CANCELLED  = 2,
+    };
+
+    // Called once, when the last glyph of the request is done. The result is a GlyphResult
     typedef void (*FGlyphCallback)(void* cbk_ctx, int result, const char* errmsg);
 
-    bool AddGlyphs(dmhash_t fontc_path_hash, const char* text, FGlyphCallback cbk, void* cbk_ctx);
+    // Higher priority requests are always generated first
+    enum Priority
+    {
+        PRIORITY_URGENT,    // Glyphs needed right now (e.g. visible text)
+        PRIORITY_NORMAL,
+        PRIORITY_IDLE,      // Background prefetching. Throttled to not use all the worker threads
+    };
+
+    // Returns the request id, or 0 if it failed
+    uint32_t AddGlyphs(dmhash_t fontc_path_hash, const char* text, Priority priority, FGlyphCallback cbk, void* cbk_ctx);
+    // Stops generating the remaining glyphs of the request. The callback is still called, with GLYPH_RESULT_CANCELLED.
+    // Returns false if the request is unknown, or already finished
+    bool Cancel(uint32_t request_id);
     bool RemoveGlyphs(dmhash_t fontc_path_hash, const char* text);
+    // Marks the glyphs as used this frame, so they're the last ones evicted when the font is over the fontgen.glyph_budget
+    bool TouchGlyphs(dmhash_t fontc_path_hash, const char* text);
+
+    struct Stats
+    {
+        uint32_t m_ArenaHighWater; // The max scratch memory (bytes) used by a single glyph job
+        uint32_t m_OutlineCacheHits;    // The glyph outline cache of the loaded ttf resources
+        uint32_t m_OutlineCacheMisses;
+        uint32_t m_UpdateDeferredFrames; // The number of updates that ran out of the fontgen.update_budget time
+        uint32_t m_UpdateDeferredGlyphs; // The finished glyphs that were left for the next frame, summed over all updates
+        uint32_t m_UpdateMaxDeferred;    // The max number of finished glyphs left for the next frame
+        uint32_t m_GlyphsEvicted;        // The number of least recently used glyphs removed to make room for new ones
+        uint32_t m_DiskCacheHits;        // The glyphs loaded from the disk cache (see fontgen.disk_cache_size)
+        uint32_t m_DiskCacheMisses;
+        uint32_t m_DistanceCacheHits;    // The distance fields shared between fonts with the same ttf and size (see fontgen.distance_cache_size)
+        uint32_t m_DistanceCacheMisses;
+    };
+
+    void GetStats(Stats* stats);
 }
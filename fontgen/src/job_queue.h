@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h> // malloc
+#include <assert.h>
+
+#include <dmsdk/dlib/atomic.h>
+
+namespace dmFontGen
+{
+
+/*
+ * A bounded lock free multi producer / multi consumer queue
+ * ("Bounded MPMC queue", Dmitry Vyukov).
+ * Each cell has a sequence number, telling whether it's ready to be written or read for the current lap.
+ * The positions are 32 bit counters, and are compared with wrap around.
+ * Push() fails if the queue is full, and Pop() fails if it's empty. The capacity must be a power of two
+ */
+template <typename T>
+class JobQueue
+{
+public:
+    JobQueue() : m_Cells(0), m_Mask(0), m_PushPos(0), m_PopPos(0) {}
+    ~JobQueue()                                 { free(m_Cells); }
+
+    void SetCapacity(uint32_t capacity)
+    {
+        assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        free(m_Cells);
+        m_Cells = (Cell*)malloc(capacity * sizeof(Cell));
+        m_Mask = capacity - 1;
+        for (uint32_t i = 0; i < capacity; ++i)
+            m_Cells[i].m_Sequence = (int32_t)i;
+        m_PushPos = 0;
+        m_PopPos = 0;
+    }
+
+    uint32_t Capacity() const                   { return m_Mask + 1; }
+
+    bool Push(const T& item)
+    {
+        Cell* cell;
+        uint32_t pos = (uint32_t)dmAtomicGet32(&m_PushPos);
+        while (true)
+        {
+            cell = &m_Cells[pos & m_Mask];
+            uint32_t seq = (uint32_t)dmAtomicGet32(&cell->m_Sequence);
+            int32_t diff = (int32_t)(seq - pos);
+            if (diff == 0)
+            {
+                // The cell is free for this lap, try to claim it
+                if ((uint32_t)dmAtomicCompareStore32(&m_PushPos, (int32_t)(pos + 1), (int32_t)pos) == pos)
+                    break;
+                pos = (uint32_t)dmAtomicGet32(&m_PushPos);
+            }
+            else if (diff < 0)
+            {
+                return false; // Full, the cell is still waiting to be read from the previous lap
+            }
+            else
+            {
+                pos = (uint32_t)dmAtomicGet32(&m_PushPos);
+            }
+        }
+
+        cell->m_Item = item;
+        dmAtomicStore32(&cell->m_Sequence, (int32_t)(pos + 1)); // Publish to the consumers
+        return true;
+    }
+
+    bool Pop(T* item)
+    {
+        Cell* cell;
+        uint32_t pos = (uint32_t)dmAtomicGet32(&m_PopPos);
+        while (true)
+        {
+            cell = &m_Cells[pos & m_Mask];
+            uint32_t seq = (uint32_t)dmAtomicGet32(&cell->m_Sequence);
+            int32_t diff = (int32_t)(seq - (pos + 1));
+            if (diff == 0)
+            {
+                if ((uint32_t)dmAtomicCompareStore32(&m_PopPos, (int32_t)(pos + 1), (int32_t)pos) == pos)
+                    break;
+                pos = (uint32_t)dmAtomicGet32(&m_PopPos);
+            }
+            else if (diff < 0)
+            {
+                return false; // Empty
+            }
+            else
+            {
+                pos = (uint32_t)dmAtomicGet32(&m_PopPos);
+            }
+        }
+
+        *item = cell->m_Item;
+        dmAtomicStore32(&cell->m_Sequence, (int32_t)(pos + m_Mask + 1)); // Free for the next lap
+        return true;
+    }
+
+    /*
+     * Pop() for a queue with a single consumer (e.g. the main thread), which needs no compare and swap
+     */
+    bool PopSingleConsumer(T* item)
+    {
+        uint32_t pos = (uint32_t)m_PopPos;
+        Cell* cell = &m_Cells[pos & m_Mask];
+        uint32_t seq = (uint32_t)dmAtomicGet32(&cell->m_Sequence);
+        if (seq != pos + 1)
+            return false; // Empty, or the producer hasn't published the item yet
+
+        *item = cell->m_Item;
+        m_PopPos = (int32_t)(pos + 1);
+        dmAtomicStore32(&cell->m_Sequence, (int32_t)(pos + m_Mask + 1));
+        return true;
+    }
+
+    /*
+     * Approximate, as the queue may change at any time
+     */
+    bool Empty()
+    {
+        return dmAtomicGet32(&m_PushPos) == dmAtomicGet32(&m_PopPos);
+    }
+
+    /*
+     * Approximate, as the queue may change at any time. Includes the items being pushed, but not yet published
+     */
+    uint32_t Size()
+    {
+        return (uint32_t)dmAtomicGet32(&m_PushPos) - (uint32_t)dmAtomicGet32(&m_PopPos);
+    }
+
+private:
+    struct Cell
+    {
+        int32_atomic_t  m_Sequence;
+        T               m_Item;
+    };
+
+    JobQueue(const JobQueue&);
+    JobQueue& operator=(const JobQueue&);
+
+    Cell*           m_Cells;
+    uint32_t        m_Mask;
+    // On separate cache lines, as they're written by different threads
+    uint8_t         m_Pad0[64];
+    int32_atomic_t  m_PushPos;
+    uint8_t         m_Pad1[64];
+    int32_atomic_t  m_PopPos;
+    uint8_t         m_Pad2[64];
+};
+
+} // namespace
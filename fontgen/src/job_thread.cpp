@@ -24,8 +24,9 @@
 #include <dmsdk/dlib/math.h>
 #include <dmsdk/dlib/dstrings.h>
 
+// Define DM_FONTGEN_NO_THREADS to test the single threaded mode on other platforms
 #define DM_HAS_THREADS
-#if defined(__EMSCRIPTEN__)
+#if defined(__EMSCRIPTEN__) || defined(DM_FONTGEN_NO_THREADS)
     #undef DM_HAS_THREADS
 #endif
 
@@ -34,6 +35,7 @@
     #include <dmsdk/dlib/mutex.h>
 #endif
 
+#include "job_queue.h"
 #include "ringbuffer.h"
 #include "job_thread.h"
 
@@ -42,101 +44,321 @@ namespace dmFontGen
 namespace dmJobThread
 {
 
+// The max number of jobs in the lock free queues (queued, processing or done). Must be a power of two
+static const uint32_t JOB_QUEUE_CAPACITY = 256;
+// The max number of released RunParallel() tasks kept for reuse. More than the calls in flight (one per thread). Must be a power of two
+static const uint32_t PARALLEL_TASK_POOL_CAPACITY = 32;
+// The max number of jobs in flight for each priority, so that the lower lanes never use up the room for the higher ones
+static const uint32_t JOB_LANE_MAX_IN_FLIGHT[MAX_JOB_PRIORITY] = {
+    JOB_QUEUE_CAPACITY,         // urgent
+    JOB_QUEUE_CAPACITY - 32,    // normal
+    32,                         // idle
+};
+// Big enough for all the jobs of a lane to have the same affinity. Must be powers of two
+static const uint32_t JOB_LANE_QUEUE_CAPACITY[MAX_JOB_PRIORITY] = { 256, 256, 32 };
+
 struct JobItem
 {
     void*       m_Context;
     void*       m_Data;
     FProcess    m_Process;
     FCallback   m_Callback;
+    uint32_t    m_Affinity;
+    uint8_t     m_Priority;
     int         m_Result;
 };
 
+struct JobThreadContext;
+
+// A range of indices, shared between the caller of RunParallel() and the helping workers
+struct ParallelTask
+{
+    JobThreadContext* m_Owner;  // Gets the task back in its pool when it's released
+    FRangeProcess   m_Process;
+    void*           m_Context;
+    uint32_t        m_Count;
+    int32_atomic_t  m_Next;     // The next index to process
+    int32_atomic_t  m_Done;     // The number of processed indices
+    int32_atomic_t  m_RefCount; // The caller + the queued helper jobs
+};
+
+// The jobs of one priority
+struct JobLane
+{
+    JobQueue<JobItem>*                      m_Work;     // One queue per worker, pushed by the main thread. Idle workers steal from the others
+
+    // Only accessed by the main thread
+    jc::RingBuffer<JobItem>                 m_Pending;  // Jobs waiting for room in the lock free queues
+    uint32_t                                m_InFlight;
+};
+
 struct JobThreadContext
 {
-    jc::RingBuffer<JobItem>                 m_Work;
-    jc::RingBuffer<JobItem>                 m_Done;
+    JobQueue<JobItem>                       m_Help;     // Helper jobs for RunParallel(), prioritized over the lanes. Never put in m_Done
+    JobQueue<ParallelTask*>                 m_FreeTasks; // The released tasks of RunParallel(), so that banded glyphs don't allocate
+    JobLane                                 m_Lanes[MAX_JOB_PRIORITY]; // The workers always serve the higher lanes first
+    uint32_t                                m_NumWorkQueues;
+    JobQueue<JobItem>                       m_Done;     // Pushed by the workers, popped by the main thread
+
+    // The number of workers processing an idle job, and the max allowed
+    int32_atomic_t                          m_NumRunningIdle;
+    int32_t                                 m_MaxRunningIdle;
+
+    // Only accessed by the main thread
+#if !defined(DM_HAS_THREADS)
+    JobItem                                 m_Current;  // A job that yielded, and is resumed in the next update
+    bool                                    m_HasCurrent;
+    uint64_t                                m_Deadline; // Set while the jobs are processed in Update()
+#endif
+    jc::RingBuffer<JobItem>                 m_Cancelled; // Pending jobs removed by CancelJobs(), their callbacks are called in Update()
+    uint32_t                                m_InFlight; // Jobs in the lanes, being processed or in m_Done. Never more than JOB_QUEUE_CAPACITY
+    uint32_t                                m_NextWorkQueue; // For the round robin of the jobs without affinity
 
 #if defined(DM_HAS_THREADS)
+    // Only used by the workers to sleep when there's no work
     dmMutex::HMutex                         m_Mutex;
     dmConditionVariable::HConditionVariable m_WakeupCond;
-    bool                                    m_Run;
+    int32_atomic_t                          m_NumSleeping;
+    int32_atomic_t                          m_Run;
 #endif
 };
 
+struct WorkerContext
+{
+    JobThreadContext*   m_ThreadContext;
+    uint32_t            m_Index;    // The work queue of this worker
+};
+
 struct JobContext
 {
 #if defined(DM_HAS_THREADS)
     dmArray<dmThread::Thread> m_Threads;
+    dmArray<WorkerContext>    m_Workers;
 #endif
     JobThreadContext    m_ThreadContext;
 };
 
-static void PutWork(JobThreadContext* ctx, const JobItem* item)
+static uint32_t GetWorkQueue(JobThreadContext* ctx, const JobItem* item)
+{
+    if (item->m_Affinity != AFFINITY_NONE)
+        return item->m_Affinity % ctx->m_NumWorkQueues;
+    uint32_t index = ctx->m_NextWorkQueue;
+    ctx->m_NextWorkQueue = (index + 1) % ctx->m_NumWorkQueues;
+    return index;
+}
+
+// Pops from the worker's own queue first, then tries to steal from the others
+static bool PopLane(JobThreadContext* ctx, JobLane* lane, uint32_t worker, JobItem* item)
+{
+    uint32_t num_queues = ctx->m_NumWorkQueues;
+    for (uint32_t i = 0; i < num_queues; ++i)
+    {
+        if (lane->m_Work[(worker + i) % num_queues].Pop(item))
+            return true;
+    }
+    return false;
+}
+
+static bool IsLaneEmpty(JobThreadContext* ctx, JobLane* lane)
+{
+    for (uint32_t i = 0; i < ctx->m_NumWorkQueues; ++i)
+    {
+        if (!lane->m_Work[i].Empty())
+            return false;
+    }
+    return true;
+}
+
+// Idle jobs are throttled, so they never occupy all the workers
+static bool CanRunIdle(JobThreadContext* ctx)
+{
+    return dmAtomicGet32(&ctx->m_NumRunningIdle) < ctx->m_MaxRunningIdle;
+}
+
+static bool PopWork(JobThreadContext* ctx, uint32_t worker, JobItem* item)
+{
+    if (PopLane(ctx, &ctx->m_Lanes[JOB_PRIORITY_URGENT], worker, item))
+        return true;
+    if (PopLane(ctx, &ctx->m_Lanes[JOB_PRIORITY_NORMAL], worker, item))
+        return true;
+
+    if (dmAtomicIncrement32(&ctx->m_NumRunningIdle) < ctx->m_MaxRunningIdle)
+    {
+        if (PopLane(ctx, &ctx->m_Lanes[JOB_PRIORITY_IDLE], worker, item))
+            return true; // Decremented when the job is done
+    }
+    dmAtomicDecrement32(&ctx->m_NumRunningIdle);
+    return false;
+}
+
+static bool HasWork(JobThreadContext* ctx)
+{
+    if (!ctx->m_Help.Empty())
+        return true;
+    if (!IsLaneEmpty(ctx, &ctx->m_Lanes[JOB_PRIORITY_URGENT]) || !IsLaneEmpty(ctx, &ctx->m_Lanes[JOB_PRIORITY_NORMAL]))
+        return true;
+    return CanRunIdle(ctx) && !IsLaneEmpty(ctx, &ctx->m_Lanes[JOB_PRIORITY_IDLE]);
+}
+
+static void WakeWorkers(JobThreadContext* ctx, bool all)
 {
 #if defined(DM_HAS_THREADS)
+    // A worker increments m_NumSleeping before checking the queues, so it either sees the new item, or gets the signal
+    if (dmAtomicGet32(&ctx->m_NumSleeping) == 0)
+        return;
     DM_MUTEX_SCOPED_LOCK(ctx->m_Mutex);
+    if (all)
+        dmConditionVariable::Broadcast(ctx->m_WakeupCond);
+    else
+        dmConditionVariable::Signal(ctx->m_WakeupCond);
 #endif
-    if (ctx->m_Work.Full())
-        ctx->m_Work.SetCapacity(ctx->m_Work.Capacity() + 8);
-    ctx->m_Work.Push(*item);
 }
 
+// Moves the pending jobs to the work queues, highest priority first,
+// as long as there's room for them in their lane and in the done queue
+static void SubmitPending(JobThreadContext* ctx)
+{
+    uint32_t num_submitted = 0;
+    for (uint32_t p = 0; p < MAX_JOB_PRIORITY; ++p)
+    {
+        JobLane* lane = &ctx->m_Lanes[p];
+        while (!lane->m_Pending.Empty() && lane->m_InFlight < JOB_LANE_MAX_IN_FLIGHT[p] && ctx->m_InFlight < JOB_QUEUE_CAPACITY)
+        {
+            JobItem item = lane->m_Pending.Pop();
+            bool result = lane->m_Work[GetWorkQueue(ctx, &item)].Push(item);
+            assert(result);
+            (void)result;
+            lane->m_InFlight++;
+            ctx->m_InFlight++;
+            num_submitted++;
+        }
+    }
+    if (num_submitted)
+        WakeWorkers(ctx, num_submitted > 1);
+}
+
+// Makes room for 'count' more pending jobs, growing geometrically
+static void ReservePending(JobLane* lane, uint32_t count)
+{
+    uint32_t size = lane->m_Pending.Size();
+    uint32_t capacity = lane->m_Pending.Capacity();
+    if (size + count <= capacity)
+        return;
+    capacity = dmMath::Max(capacity * 2, 32U);
+    while (capacity < size + count)
+        capacity *= 2;
+    lane->m_Pending.SetCapacity(capacity);
+}
+
+
 static void PutDone(JobThreadContext* ctx, JobItem* item)
 {
-#if defined(DM_HAS_THREADS)
-    DM_MUTEX_SCOPED_LOCK(ctx->m_Mutex);
-#endif
-    if (ctx->m_Done.Full())
-        ctx->m_Done.SetCapacity(ctx->m_Done.Capacity() + 8);
-    ctx->m_Done.Push(*item);
+    // Never full, since the number of jobs in flight is limited by the main thread
+    bool result = ctx->m_Done.Push(*item);
+    assert(result);
+    (void)result;
 }
 
-#if defined(DM_HAS_THREADS)
-static void JobThread(void* _ctx)
+static void FinishWork(JobThreadContext* ctx, JobItem* item)
+{
+    if (item->m_Priority == JOB_PRIORITY_IDLE)
+        dmAtomicDecrement32(&ctx->m_NumRunningIdle);
+    PutDone(ctx, item);
+}
+
+static void ProcessWork(JobThreadContext* ctx, JobItem* item)
+{
+    // The workers have no deadline, but a job may still yield
+    do
+    {
+        item->m_Result = item->m_Process(item->m_Context, item->m_Data);
+    } while (item->m_Result == JOB_RESULT_YIELD);
+    FinishWork(ctx, item);
+}
+
+static void ProcessParallelTask(ParallelTask* task)
 {
-    JobThreadContext* ctx = (JobThreadContext*)_ctx;
     while (true)
     {
-        JobItem item = {};
-        {
-            DM_MUTEX_SCOPED_LOCK(ctx->m_Mutex);
+        uint32_t index = (uint32_t)dmAtomicIncrement32(&task->m_Next);
+        if (index >= task->m_Count)
+            break;
+        task->m_Process(task->m_Context, index);
+        dmAtomicIncrement32(&task->m_Done);
+    }
+}
 
-            if (!ctx->m_Run)
-                break;
+static void ReleaseParallelTask(ParallelTask* task)
+{
+    if (dmAtomicDecrement32(&task->m_RefCount) != 1)
+        return;
+    // Released by the last worker or by the caller, so the pool is pushed from any thread
+    if (!task->m_Owner->m_FreeTasks.Push(task))
+        delete task;
+}
 
-            while(ctx->m_Work.Empty())
-            {
-                dmConditionVariable::Wait(ctx->m_WakeupCond, ctx->m_Mutex);
-                if (!ctx->m_Run)
-                    return;
-            }
-            item = ctx->m_Work.Pop();
-        }
+static int HelpParallelTask(void* context, void* data)
+{
+    ParallelTask* task = (ParallelTask*)data;
+    ProcessParallelTask(task);
+    ReleaseParallelTask(task);
+    return 0;
+}
 
+#if defined(DM_HAS_THREADS)
+static void JobThread(void* _ctx)
+{
+    WorkerContext* worker = (WorkerContext*)_ctx;
+    JobThreadContext* ctx = worker->m_ThreadContext;
+    while (dmAtomicGet32(&ctx->m_Run))
+    {
+        JobItem item;
+        if (ctx->m_Help.Pop(&item))
         {
             DM_PROFILE("FontGenJobThread");
-            item.m_Result = item.m_Process(item.m_Context, item.m_Data);
-            PutDone(ctx, &item);
+            item.m_Process(item.m_Context, item.m_Data);
+            continue;
         }
+        if (PopWork(ctx, worker->m_Index, &item))
+        {
+            DM_PROFILE("FontGenJobThread");
+            ProcessWork(ctx, &item);
+            continue;
+        }
+
+        // Sleep until more work is pushed
+        DM_MUTEX_SCOPED_LOCK(ctx->m_Mutex);
+        dmAtomicIncrement32(&ctx->m_NumSleeping);
+        while (dmAtomicGet32(&ctx->m_Run) && !HasWork(ctx))
+            dmConditionVariable::Wait(ctx->m_WakeupCond, ctx->m_Mutex);
+        dmAtomicDecrement32(&ctx->m_NumSleeping);
     }
 }
 #else
-static void UpdateSingleThread(JobThreadContext* ctx, uint64_t max_time)
+// Processes jobs until the deadline (0 means no deadline).
+// A job that yields (e.g. a large glyph) is resumed first thing in the next update
+static void UpdateSingleThread(JobThreadContext* ctx, uint64_t deadline)
 {
-    while (!ctx->m_Work.Empty())
+    ctx->m_Deadline = deadline;
+    while (ctx->m_HasCurrent || PopWork(ctx, 0, &ctx->m_Current))
     {
-        uint64_t tstart = dmTime::GetTime();
-        JobItem item = ctx->m_Work.Pop();
+        JobItem* item = &ctx->m_Current;
+        item->m_Result = item->m_Process(item->m_Context, item->m_Data);
+        if (item->m_Result == JOB_RESULT_YIELD)
+        {
+            ctx->m_HasCurrent = true;
+            break;
+        }
 
-        item.m_Result = item.m_Process(item.m_Context, item.m_Data);
-        PutDone(ctx, &item);
+        ctx->m_HasCurrent = false;
+        FinishWork(ctx, item);
 
-        uint64_t tend = dmTime::GetTime();
-        if ((tend-tstart) > max_time)
+        if (deadline && dmTime::GetTime() >= deadline)
         {
             break;
         }
     }
+    ctx->m_Deadline = 0;
 }
 #endif
 
@@ -144,19 +366,51 @@ HContext Create(const JobThreadCreationParams& create_params)
 {
     JobContext* context = new JobContext;
 #if defined(DM_HAS_THREADS)
-    context->m_ThreadContext.m_Mutex = dmMutex::New();
-    context->m_ThreadContext.m_WakeupCond = dmConditionVariable::New();
-    context->m_ThreadContext.m_Run = true;
-
     uint32_t thread_count = dmMath::Min(create_params.m_ThreadCount, DM_MAX_JOB_THREAD_COUNT);
+#else
+    uint32_t thread_count = 0;
+#endif
+
+    JobThreadContext* ctx = &context->m_ThreadContext;
+    ctx->m_NumWorkQueues = dmMath::Max(1U, thread_count); // Non threaded builds process the first queue on the main thread
+    for (uint32_t p = 0; p < MAX_JOB_PRIORITY; ++p)
+    {
+        JobLane* lane = &ctx->m_Lanes[p];
+        lane->m_Work = new JobQueue<JobItem>[ctx->m_NumWorkQueues];
+        for (uint32_t i = 0; i < ctx->m_NumWorkQueues; ++i)
+            lane->m_Work[i].SetCapacity(JOB_LANE_QUEUE_CAPACITY[p]);
+        lane->m_InFlight = 0;
+    }
+    ctx->m_Help.SetCapacity(JOB_QUEUE_CAPACITY);
+    ctx->m_FreeTasks.SetCapacity(PARALLEL_TASK_POOL_CAPACITY);
+    ctx->m_Done.SetCapacity(JOB_QUEUE_CAPACITY);
+    ctx->m_NumRunningIdle = 0;
+    ctx->m_MaxRunningIdle = dmMath::Max(1U, thread_count / 2);
+    ctx->m_InFlight = 0;
+    ctx->m_NextWorkQueue = 0;
+#if !defined(DM_HAS_THREADS)
+    ctx->m_HasCurrent = false;
+    ctx->m_Deadline = 0;
+#endif
+#if defined(DM_HAS_THREADS)
+    ctx->m_Mutex = dmMutex::New();
+    ctx->m_WakeupCond = dmConditionVariable::New();
+    ctx->m_NumSleeping = 0;
+    ctx->m_Run = 1;
+
     context->m_Threads.SetCapacity(thread_count);
     context->m_Threads.SetSize(thread_count);
+    context->m_Workers.SetCapacity(thread_count);
+    context->m_Workers.SetSize(thread_count);
 
     for (int i = 0; i < thread_count; ++i)
     {
+        context->m_Workers[i].m_ThreadContext = ctx;
+        context->m_Workers[i].m_Index = i;
+
         char name_buf[128];
         dmSnPrintf(name_buf, sizeof(name_buf), "%s_%d", create_params.m_ThreadNames[i], i);
-        context->m_Threads[i] = dmThread::New(JobThread, 0x80000, (void*)&context->m_ThreadContext, name_buf);
+        context->m_Threads[i] = dmThread::New(JobThread, 0x80000, (void*)&context->m_Workers[i], name_buf);
     }
 #endif
     return context;
@@ -171,7 +425,7 @@ void Destroy(HContext context)
     {
         DM_MUTEX_SCOPED_LOCK(context->m_ThreadContext.m_Mutex);
 
-        context->m_ThreadContext.m_Run = false;;
+        dmAtomicStore32(&context->m_ThreadContext.m_Run, 0);
 
         dmConditionVariable::Broadcast(context->m_ThreadContext.m_WakeupCond);
     }
@@ -184,21 +438,83 @@ void Destroy(HContext context)
     dmMutex::Delete(context->m_ThreadContext.m_Mutex);
 #endif // DM_HAS_THREADS
 
+    // The helper jobs that were never picked up still hold their tasks
+    JobThreadContext* ctx = &context->m_ThreadContext;
+    JobItem item;
+    while (ctx->m_Help.Pop(&item))
+        ReleaseParallelTask((ParallelTask*)item.m_Data);
+    ParallelTask* task;
+    while (ctx->m_FreeTasks.Pop(&task))
+        delete task;
+
+    for (uint32_t p = 0; p < MAX_JOB_PRIORITY; ++p)
+        delete[] ctx->m_Lanes[p].m_Work;
     delete context;
 }
 
-void PushJob(HContext context, FProcess process, FCallback callback, void* user_context, void* data)
+void PushJob(HContext context, FProcess process, FCallback callback, void* user_context, void* data, uint32_t affinity, JobPriority priority)
 {
+    PushJobs(context, process, callback, user_context, &data, 1, affinity, priority);
+}
+
+void PushJobs(HContext context, FProcess process, FCallback callback, void* user_context, void** data, uint32_t count, uint32_t affinity, JobPriority priority)
+{
+    if (count == 0)
+        return;
+
+    JobThreadContext* ctx = &context->m_ThreadContext;
+    JobLane* lane = &ctx->m_Lanes[priority];
+    ReservePending(lane, count);
+
     JobItem item;
     item.m_Context = user_context;
-    item.m_Data = data;
     item.m_Process = process;
     item.m_Callback = callback;
+    item.m_Affinity = affinity;
+    item.m_Priority = (uint8_t)priority;
     item.m_Result = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        item.m_Data = data[i];
+        lane->m_Pending.Push(item);
+    }
+
+    // Submits as many as there's room for, and wakes the workers once
+    SubmitPending(ctx);
+}
 
-    PutWork(&context->m_ThreadContext, &item);
+uint32_t CancelJobs(HContext context, FMatch match, void* match_context)
+{
+    JobThreadContext* ctx = &context->m_ThreadContext;
+    uint32_t num_cancelled = 0;
+    for (uint32_t p = 0; p < MAX_JOB_PRIORITY; ++p)
+    {
+        // Rotates the whole buffer once, keeping the order of the remaining jobs
+        jc::RingBuffer<JobItem>& pending = ctx->m_Lanes[p].m_Pending;
+        uint32_t size = pending.Size();
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            JobItem item = pending.Pop();
+            if (!match(match_context, item.m_Data))
+            {
+                pending.Push(item);
+                continue;
+            }
+            if (ctx->m_Cancelled.Full())
+                ctx->m_Cancelled.SetCapacity(dmMath::Max(ctx->m_Cancelled.Capacity() * 2, 32U));
+            ctx->m_Cancelled.Push(item);
+            num_cancelled++;
+        }
+    }
+    return num_cancelled;
+}
+
+uint64_t GetDeadline(HContext context)
+{
 #if defined(DM_HAS_THREADS)
-    dmConditionVariable::Signal(context->m_ThreadContext.m_WakeupCond);
+    return 0;
+#else
+    return context->m_ThreadContext.m_Deadline;
 #endif
 }
 
@@ -211,37 +527,91 @@ uint32_t GetWorkerCount(HContext context)
 #endif
 }
 
-void Update(JobContext* context, uint64_t max_time)
+void RunParallel(HContext context, FRangeProcess process, void* user_context, uint32_t count)
 {
-    DM_PROFILE("Update");
+    uint32_t num_helpers = dmMath::Min(count, GetWorkerCount(context));
+    if (num_helpers > 0)
+        num_helpers--; // The calling thread takes one share of the work
 
-#if !defined(DM_HAS_THREADS)
-    UpdateSingleThread(&context->m_ThreadContext, max_time);
+    if (num_helpers == 0)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            process(user_context, i);
+        return;
+    }
+
+#if defined(DM_HAS_THREADS)
+    DM_PROFILE("RunParallel");
+
+    // The task outlives this call if a helper job is still queued when the work is done
+    JobThreadContext* ctx = &context->m_ThreadContext;
+    ParallelTask* task;
+    if (!ctx->m_FreeTasks.Pop(&task))
+        task = new ParallelTask;
+    task->m_Owner = ctx;
+    task->m_Process = process;
+    task->m_Context = user_context;
+    task->m_Count = count;
+    task->m_Next = 0;
+    task->m_Done = 0;
+    task->m_RefCount = 1 + num_helpers;
+
+    JobItem item = {};
+    item.m_Data = task;
+    item.m_Process = HelpParallelTask;
+    for (uint32_t i = 0; i < num_helpers; ++i)
+    {
+        if (!ctx->m_Help.Push(item))
+            ReleaseParallelTask(task); // The queue is full, do the work with fewer helpers
+    }
+    WakeWorkers(ctx, true);
+
+    ProcessParallelTask(task);
+
+    // Wait for the indices that are still being processed by the helpers
+    while ((uint32_t)dmAtomicGet32(&task->m_Done) < count)
+        dmTime::Sleep(0);
+
+    ReleaseParallelTask(task);
 #endif
+}
 
-    // Lock for as little as possible, by copying the items to an array owned by this thread
-    uint32_t size;
-    dmArray<JobItem> items;
+uint32_t Update(JobContext* context, uint64_t max_time)
+{
+    DM_PROFILE("Update");
 
-    {
-#if defined(DM_HAS_THREADS)
-        DM_MUTEX_SCOPED_LOCK(context->m_ThreadContext.m_Mutex);
+    uint64_t deadline = max_time ? dmTime::GetTime() + max_time : 0;
+
+    JobThreadContext* ctx = &context->m_ThreadContext;
+#if !defined(DM_HAS_THREADS)
+    UpdateSingleThread(ctx, deadline);
 #endif
-        size = context->m_ThreadContext.m_Done.Size();
-        items.SetCapacity(size);
 
-        for(uint32_t i = 0; i < size; ++i)
-            items.Push(context->m_ThreadContext.m_Done[i]);
-        context->m_ThreadContext.m_Done.Clear();
+    // At least one callback is called each update, so the jobs always make progress.
+    // The rest are left for the next update when the time is up
+    bool time_is_up = false;
+    JobItem item;
+    while (!time_is_up && !ctx->m_Cancelled.Empty())
+    {
+        item = ctx->m_Cancelled.Pop();
+        if (item.m_Callback)
+            item.m_Callback(item.m_Context, item.m_Data, JOB_RESULT_CANCELLED);
+        time_is_up = deadline && dmTime::GetTime() >= deadline;
     }
 
-    // Now do the callbacks
-    for(uint32_t i = 0; i < size; ++i)
+    // Lock free, so this never waits for a worker
+    while (!time_is_up && ctx->m_Done.PopSingleConsumer(&item))
     {
-        JobItem& item = items[i];
+        ctx->m_InFlight--;
+        ctx->m_Lanes[item.m_Priority].m_InFlight--;
         if (item.m_Callback)
             item.m_Callback(item.m_Context, item.m_Data, item.m_Result);
+        time_is_up = deadline && dmTime::GetTime() >= deadline;
     }
+
+    SubmitPending(ctx);
+
+    return time_is_up ? ctx->m_Cancelled.Size() + ctx->m_Done.Size() : 0;
 }
 
 } // namespace dmJobThread
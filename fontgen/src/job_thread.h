@@ -24,8 +24,23 @@ namespace dmJobThread
     typedef struct JobContext* HContext;
     typedef int (*FProcess)(void* context, void* data);
     typedef void (*FCallback)(void* context, void* data, int result);
+    typedef void (*FRangeProcess)(void* context, uint32_t index);
+    typedef bool (*FMatch)(void* context, void* data);
 
     static const uint8_t DM_MAX_JOB_THREAD_COUNT = 8;
+    static const uint32_t AFFINITY_NONE = 0xFFFFFFFF;
+    static const int JOB_RESULT_CANCELLED = -1; // Passed to the callback of a job removed by CancelJobs()
+    static const int JOB_RESULT_YIELD = -2;     // Returned by a job that ran out of time (see GetDeadline()). It's called again later
+
+    // The workers always pick the jobs from the highest priority first.
+    // At most half of the workers process idle jobs at the same time
+    enum JobPriority
+    {
+        JOB_PRIORITY_URGENT,
+        JOB_PRIORITY_NORMAL,
+        JOB_PRIORITY_IDLE,
+        MAX_JOB_PRIORITY
+    };
 
     struct JobThreadCreationParams
     {
@@ -35,9 +50,31 @@ namespace dmJobThread
 
     HContext Create(const JobThreadCreationParams& create_params);
     void     Destroy(HContext context);
-    void     Update(HContext context, uint64_t max_time_us); // Flushes any finished items and calls PostProcess
-    void     PushJob(HContext context, FProcess process, FCallback callback, void* user_context, void* data);
+    // Calls the callbacks of the finished jobs, until max_time_us (0 means no limit) is used up.
+    // Returns the number of finished jobs left for the next update
+    uint32_t Update(HContext context, uint64_t max_time_us);
+    // Each worker has its own queue, and steals from the others when idle.
+    // Jobs with the same affinity (e.g. from the same font) go to the same worker, to keep its caches warm.
+    // Jobs with AFFINITY_NONE are distributed round robin
+    void     PushJob(HContext context, FProcess process, FCallback callback, void* user_context, void* data, uint32_t affinity, JobPriority priority);
+    // Pushes one job for each of the 'count' data pointers, with the same process, callback, context and affinity.
+    // Cheaper than calling PushJob() for each of them, as the workers are only woken once
+    void     PushJobs(HContext context, FProcess process, FCallback callback, void* user_context, void** data, uint32_t count, uint32_t affinity, JobPriority priority);
+    // Removes the queued jobs that haven't been picked up by a worker yet, for which match() returns true.
+    // Their callbacks are still called from Update(), with the result JOB_RESULT_CANCELLED.
+    // Jobs already handed to the workers are not affected, so the process function should also check for cancellation.
+    // Returns the number of removed jobs
+    uint32_t CancelJobs(HContext context, FMatch match, void* match_context);
     uint32_t GetWorkerCount(HContext context);
+
+    // On platforms without threads, the jobs run on the main thread within Update(), and this returns the time (dmTime::GetTime())
+    // when the job should return JOB_RESULT_YIELD, and continue in a later call. Returns 0 if there's no deadline
+    uint64_t GetDeadline(HContext context);
+
+    // Calls process for each index in [0, count), using the idle workers to help out.
+    // The calling thread takes part in the work, so it's safe to call from within a job.
+    // Returns when all indices are processed
+    void     RunParallel(HContext context, FRangeProcess process, void* user_context, uint32_t count);
 }
 }
 
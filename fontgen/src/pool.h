@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h> // malloc
+#include <assert.h>
+
+namespace dmFontGen
+{
+
+/*
+ * A pool of fixed size objects, allocated in slabs and recycled through a free list.
+ * Once the pool has grown to the peak usage, Alloc() and Free() never touch the heap.
+ * The objects are not constructed or destructed. Not thread safe
+ */
+template <typename T, uint32_t SLAB_SIZE = 64>
+class ObjectPool
+{
+public:
+    ObjectPool() : m_Slabs(0), m_FreeList(0), m_NumAllocated(0), m_Capacity(0) {}
+    ~ObjectPool()
+    {
+        while (m_Slabs)
+        {
+            Slab* next = m_Slabs->m_Next;
+            free(m_Slabs);
+            m_Slabs = next;
+        }
+    }
+
+    T* Alloc()
+    {
+        if (!m_FreeList)
+            AddSlab();
+        Node* node = m_FreeList;
+        m_FreeList = node->m_Next;
+        m_NumAllocated++;
+        return (T*)node;
+    }
+
+    void Free(T* object)
+    {
+        assert(m_NumAllocated > 0);
+        Node* node = (Node*)object;
+        node->m_Next = m_FreeList;
+        m_FreeList = node;
+        m_NumAllocated--;
+    }
+
+    uint32_t Size() const                       { return m_NumAllocated; }
+    uint32_t Capacity() const                   { return m_Capacity; }
+
+private:
+    union Node
+    {
+        Node*   m_Next;
+        T       m_Object;
+    };
+
+    struct Slab
+    {
+        Slab*   m_Next;
+        Node    m_Nodes[SLAB_SIZE];
+    };
+
+    void AddSlab()
+    {
+        Slab* slab = (Slab*)malloc(sizeof(Slab));
+        slab->m_Next = m_Slabs;
+        m_Slabs = slab;
+        for (uint32_t i = 0; i < SLAB_SIZE; ++i)
+        {
+            slab->m_Nodes[i].m_Next = m_FreeList;
+            m_FreeList = &slab->m_Nodes[i];
+        }
+        m_Capacity += SLAB_SIZE;
+    }
+
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+    Slab*       m_Slabs;
+    Node*       m_FreeList;
+    uint32_t    m_NumAllocated;
+    uint32_t    m_Capacity;
+};
+
+} // namespace
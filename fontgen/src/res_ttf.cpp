@@ -11,32 +11,327 @@
 // specific language governing permissions and limitations under the License.
 
 #include "res_ttf.h"
+#include "arena.h"
+#include "sdf.h"
 #include "util.h" // DebugPrintBitmap
+#include <dmsdk/dlib/atomic.h>
+#include <dmsdk/dlib/hash.h>
+#include <dmsdk/dlib/hashtable.h>
 #include <dmsdk/dlib/log.h>
+#include <dmsdk/dlib/math.h>
+#include <dmsdk/dlib/mutex.h>
+#include <dmsdk/dlib/time.h>
 #include <dmsdk/resource/resource.h>
 
 #include <stdlib.h> // free
 #include <stdio.h> // printf
 
+// The userdata of the font info is the arena of the worker (or 0), see GenerateGlyphSdf()
+#define STBTT_malloc(x,u)  dmFontGen::ArenaAlloc((dmFontGen::Arena*)(u), x)
+#define STBTT_free(x,u)    dmFontGen::ArenaFree((dmFontGen::Arena*)(u), x)
+
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
 
 namespace dmFontGen
 {
 
+static const int SDF_MIN_BAND_HEIGHT = 8; // rows
+
+static uint32_t g_OutlineCacheMaxSize = 1024 * 1024; // bytes
+static uint32_t g_DistanceCacheMaxSize = 2048 * 1024; // bytes
+
+// A decoded glyph outline, shared by all fonts using the same ttf
+struct GlyphOutline
+{
+    stbtt_vertex*   m_Vertices;
+    int             m_NumVertices;
+    uint32_t        m_LastUsed;
+    int32_atomic_t  m_RefCount; // The cache holds one reference
+};
+
+struct OutlineCache
+{
+    dmMutex::HMutex                 m_Mutex;
+    dmHashTable32<GlyphOutline*>    m_Outlines;     // glyph index -> outline
+    uint32_t                        m_Size;         // bytes
+    uint32_t                        m_UseCounter;
+    int32_atomic_t                  m_Hits;
+    int32_atomic_t                  m_Misses;
+};
+
+// A float distance field of a glyph, shared by the fonts using the same ttf and scale (see GenerateGlyphSdfShared())
+struct DistanceField
+{
+    float*          m_Distances;    // The signed distances (pixels, negative outside), m_Width*m_Height
+    uint32_t        m_GlyphIndex;
+    float           m_Scale;
+    int             m_Padding;
+    float           m_MaxDistance;  // The distances within this are exact
+    int             m_X0;           // The pixel rect of the field
+    int             m_Y0;
+    int             m_Width;
+    int             m_Height;
+    uint32_t        m_LastUsed;
+    int32_atomic_t  m_RefCount;     // The cache holds one reference
+};
+
+struct DistanceCache
+{
+    dmMutex::HMutex                 m_Mutex;
+    dmHashTable32<DistanceField*>   m_Fields;       // hash of glyph index and scale -> field
+    uint32_t                        m_Size;         // bytes
+    uint32_t                        m_Reserved;     // bytes, on top of the max size, for the fields of the queued glyphs (see ReserveDistanceCache())
+    uint32_t                        m_UseCounter;
+    int32_atomic_t                  m_Hits;
+    int32_atomic_t                  m_Misses;
+};
+
 struct TTFResource
 {
     stbtt_fontinfo  m_Font;
     const char*     m_Path;
     void*           m_Data; // The raw ttf font
+    uint64_t        m_DataHash;
 
     int             m_Ascent;
     int             m_Descent;
     int             m_LineGap;
+
+    OutlineCache    m_OutlineCache;
+    DistanceCache   m_DistanceCache;
+};
+
+static uint32_t GetOutlineSize(const GlyphOutline* outline)
+{
+    return sizeof(GlyphOutline) + outline->m_NumVertices * sizeof(stbtt_vertex);
+}
+
+static void ReleaseOutline(GlyphOutline* outline)
+{
+    if (dmAtomicDecrement32(&outline->m_RefCount) != 1)
+        return;
+    free((void*)outline->m_Vertices); // Allocated with the default STBTT_malloc, see GetOutline()
+    free((void*)outline);
+}
+
+static void ReleaseOutlineIter(void*, const uint32_t* key, GlyphOutline** outline)
+{
+    ReleaseOutline(*outline);
+}
+
+static void ClearOutlineCache(OutlineCache* cache)
+{
+    DM_MUTEX_SCOPED_LOCK(cache->m_Mutex);
+    cache->m_Outlines.Iterate(ReleaseOutlineIter, (void*)0);
+    cache->m_Outlines.Clear();
+    cache->m_Size = 0;
+}
+
+struct FindOldestOutlineContext
+{
+    uint32_t        m_GlyphIndex;
+    GlyphOutline*   m_Outline;
+};
+
+static void FindOldestOutlineIter(FindOldestOutlineContext* ctx, const uint32_t* key, GlyphOutline** outline)
+{
+    if (!ctx->m_Outline || (*outline)->m_LastUsed < ctx->m_Outline->m_LastUsed)
+    {
+        ctx->m_GlyphIndex = *key;
+        ctx->m_Outline = *outline;
+    }
+}
+
+// Evicts the least recently used outlines until the new outline fits. Called with the lock held
+static void EvictOutlines(OutlineCache* cache, uint32_t size)
+{
+    while (!cache->m_Outlines.Empty() && cache->m_Size + size > g_OutlineCacheMaxSize)
+    {
+        FindOldestOutlineContext ctx = {0, 0};
+        cache->m_Outlines.Iterate(FindOldestOutlineIter, &ctx);
+        cache->m_Outlines.Erase(ctx.m_GlyphIndex);
+        cache->m_Size -= GetOutlineSize(ctx.m_Outline);
+        ReleaseOutline(ctx.m_Outline); // Still valid for any job currently using it
+    }
+}
+
+// Gets the decoded outline of a glyph, from the cache if possible. Call ReleaseOutline() when done
+static GlyphOutline* GetOutline(TTFResource* resource, uint32_t glyph_index)
+{
+    OutlineCache* cache = &resource->m_OutlineCache;
+    {
+        DM_MUTEX_SCOPED_LOCK(cache->m_Mutex);
+        GlyphOutline** poutline = cache->m_Outlines.Get(glyph_index);
+        if (poutline)
+        {
+            GlyphOutline* outline = *poutline;
+            outline->m_LastUsed = ++cache->m_UseCounter;
+            dmAtomicIncrement32(&outline->m_RefCount);
+            dmAtomicIncrement32(&cache->m_Hits);
+            return outline;
+        }
+    }
+
+    // Decode outside of the lock. The font info has no userdata, so the vertices are allocated with malloc
+    GlyphOutline* outline = (GlyphOutline*)malloc(sizeof(GlyphOutline));
+    outline->m_Vertices = 0;
+    outline->m_NumVertices = stbtt_GetGlyphShape(&resource->m_Font, glyph_index, &outline->m_Vertices);
+    outline->m_RefCount = 1;
+    dmAtomicIncrement32(&cache->m_Misses);
+
+    uint32_t size = GetOutlineSize(outline);
+    if (size > g_OutlineCacheMaxSize)
+        return outline; // Not cached, released by the caller
+
+    DM_MUTEX_SCOPED_LOCK(cache->m_Mutex);
+    GlyphOutline** poutline = cache->m_Outlines.Get(glyph_index);
+    if (poutline)
+    {
+        // Another worker decoded the same glyph
+        ReleaseOutline(outline);
+        outline = *poutline;
+        outline->m_LastUsed = ++cache->m_UseCounter;
+        dmAtomicIncrement32(&outline->m_RefCount);
+        return outline;
+    }
+
+    EvictOutlines(cache, size);
+    if (cache->m_Outlines.Full())
+    {
+        uint32_t cap = cache->m_Outlines.Capacity() + 64;
+        cache->m_Outlines.SetCapacity((cap*2)/3, cap);
+    }
+
+    outline->m_LastUsed = ++cache->m_UseCounter;
+    outline->m_RefCount = 2; // The cache and the caller
+    cache->m_Outlines.Put(glyph_index, outline);
+    cache->m_Size += size;
+    return outline;
+}
+
+static uint32_t GetDistanceFieldSize(const DistanceField* field)
+{
+    return sizeof(DistanceField) + field->m_Width * field->m_Height * sizeof(float);
+}
+
+static void ReleaseDistanceField(DistanceField* field)
+{
+    if (dmAtomicDecrement32(&field->m_RefCount) != 1)
+        return;
+    free((void*)field->m_Distances);
+    free((void*)field);
+}
+
+static void ReleaseDistanceFieldIter(void*, const uint32_t* key, DistanceField** field)
+{
+    ReleaseDistanceField(*field);
+}
+
+static void ClearDistanceCache(DistanceCache* cache)
+{
+    DM_MUTEX_SCOPED_LOCK(cache->m_Mutex);
+    cache->m_Fields.Iterate(ReleaseDistanceFieldIter, (void*)0);
+    cache->m_Fields.Clear();
+    cache->m_Size = 0;
+}
+
+struct FindOldestFieldContext
+{
+    uint32_t        m_Key;
+    DistanceField*  m_Field;
 };
 
+static void FindOldestFieldIter(FindOldestFieldContext* ctx, const uint32_t* key, DistanceField** field)
+{
+    if (!ctx->m_Field || (*field)->m_LastUsed < ctx->m_Field->m_LastUsed)
+    {
+        ctx->m_Key = *key;
+        ctx->m_Field = *field;
+    }
+}
+
+static void EraseDistanceField(DistanceCache* cache, uint32_t key, DistanceField* field)
+{
+    cache->m_Fields.Erase(key);
+    cache->m_Size -= GetDistanceFieldSize(field);
+    ReleaseDistanceField(field); // Still valid for any job currently using it
+}
+
+// Evicts the least recently used fields until the new field fits. Called with the lock held
+static void EvictDistanceFields(DistanceCache* cache, uint32_t size)
+{
+    while (!cache->m_Fields.Empty() && cache->m_Size + size > g_DistanceCacheMaxSize + cache->m_Reserved)
+    {
+        FindOldestFieldContext ctx = {0, 0};
+        cache->m_Fields.Iterate(FindOldestFieldIter, &ctx);
+        EraseDistanceField(cache, ctx.m_Key, ctx.m_Field);
+    }
+}
+
+static uint32_t GetDistanceFieldKey(uint32_t glyph_index, float scale)
+{
+    struct { uint32_t m_GlyphIndex; float m_Scale; } key = { glyph_index, scale };
+    return dmHashBuffer32(&key, sizeof(key));
+}
+
+// Gets a cached field that covers the padding and max distance. Call ReleaseDistanceField() when done
+static DistanceField* GetDistanceField(TTFResource* resource, uint32_t glyph_index, float scale, int padding, float max_distance)
+{
+    DistanceCache* cache = &resource->m_DistanceCache;
+    DM_MUTEX_SCOPED_LOCK(cache->m_Mutex);
+    DistanceField** pfield = cache->m_Fields.Get(GetDistanceFieldKey(glyph_index, scale));
+    if (!pfield)
+    {
+        dmAtomicIncrement32(&cache->m_Misses);
+        return 0;
+    }
+
+    DistanceField* field = *pfield;
+    if (field->m_GlyphIndex != glyph_index || field->m_Scale != scale || field->m_Padding < padding || field->m_MaxDistance < max_distance)
+    {
+        dmAtomicIncrement32(&cache->m_Misses);
+        return 0; // Replaced by the caller
+    }
+
+    field->m_LastUsed = ++cache->m_UseCounter;
+    dmAtomicIncrement32(&field->m_RefCount);
+    dmAtomicIncrement32(&cache->m_Hits);
+    return field;
+}
+
+// Adds the field to the cache, replacing any older field of the glyph. The caller keeps its reference
+static void PutDistanceField(TTFResource* resource, uint32_t glyph_index, DistanceField* field)
+{
+    uint32_t size = GetDistanceFieldSize(field);
+    DistanceCache* cache = &resource->m_DistanceCache;
+    uint32_t key = GetDistanceFieldKey(glyph_index, field->m_Scale);
+    DM_MUTEX_SCOPED_LOCK(cache->m_Mutex);
+    if (size > g_DistanceCacheMaxSize + cache->m_Reserved)
+        return;
+    DistanceField** pfield = cache->m_Fields.Get(key);
+    if (pfield)
+        EraseDistanceField(cache, key, *pfield);
+
+    EvictDistanceFields(cache, size);
+    if (cache->m_Fields.Full())
+    {
+        uint32_t cap = cache->m_Fields.Capacity() + 64;
+        cache->m_Fields.SetCapacity((cap*2)/3, cap);
+    }
+
+    field->m_LastUsed = ++cache->m_UseCounter;
+    dmAtomicIncrement32(&field->m_RefCount);
+    cache->m_Fields.Put(key, field);
+    cache->m_Size += size;
+}
+
 static void DeleteResource(TTFResource* resource)
 {
+    ClearOutlineCache(&resource->m_OutlineCache);
+    dmMutex::Delete(resource->m_OutlineCache.m_Mutex);
+    ClearDistanceCache(&resource->m_DistanceCache);
+    dmMutex::Delete(resource->m_DistanceCache.m_Mutex);
     free((void*)resource->m_Data);
     free((void*)resource->m_Path);
     delete resource;
@@ -45,11 +340,24 @@ static void DeleteResource(TTFResource* resource)
 static TTFResource* CreateFont(const char* path, const void* buffer, uint32_t buffer_size)
 {
     TTFResource* resource = new TTFResource;
-    memset(resource, 0, sizeof(*resource));
+    memset(&resource->m_Font, 0, sizeof(resource->m_Font));
+    resource->m_Path = 0;
+    resource->m_OutlineCache.m_Mutex = dmMutex::New();
+    resource->m_OutlineCache.m_Size = 0;
+    resource->m_OutlineCache.m_UseCounter = 0;
+    resource->m_OutlineCache.m_Hits = 0;
+    resource->m_OutlineCache.m_Misses = 0;
+    resource->m_DistanceCache.m_Mutex = dmMutex::New();
+    resource->m_DistanceCache.m_Size = 0;
+    resource->m_DistanceCache.m_Reserved = 0;
+    resource->m_DistanceCache.m_UseCounter = 0;
+    resource->m_DistanceCache.m_Hits = 0;
+    resource->m_DistanceCache.m_Misses = 0;
 
     // Until we can rely on memory being uncompressed and memory mapped, we need to make a single copy here
     resource->m_Data = malloc(buffer_size);
     memcpy(resource->m_Data, buffer, buffer_size);
+    resource->m_DataHash = dmHashBuffer64(buffer, buffer_size);
 
     int index = stbtt_GetFontOffsetForIndex((const unsigned char*)resource->m_Data,0);
     int result = stbtt_InitFont(&resource->m_Font, (const unsigned char*)resource->m_Data, index);
@@ -103,10 +411,15 @@ static dmResource::Result TTF_Recreate(const dmResource::ResourceRecreateParams*
     void* old_data = old_resource->m_Data;
     old_resource->m_Data = new_resource->m_Data;
     new_resource->m_Data = old_data;
+    old_resource->m_DataHash = new_resource->m_DataHash;
     const char* old_path = old_resource->m_Path;
     old_resource->m_Path = new_resource->m_Path;
     new_resource->m_Path = old_path;
 
+    // The outlines and distance fields were generated from the old data
+    ClearOutlineCache(&old_resource->m_OutlineCache);
+    ClearDistanceCache(&old_resource->m_DistanceCache);
+
     DeleteResource(new_resource);
 
     dmResource::SetResource(params->m_Resource, old_resource);
@@ -139,6 +452,52 @@ const char* GetFontPath(TTFResource* resource)
     return resource->m_Path;
 }
 
+uint64_t GetFontDataHash(TTFResource* resource)
+{
+    return resource->m_DataHash;
+}
+
+void SetOutlineCacheSize(uint32_t size)
+{
+    g_OutlineCacheMaxSize = size;
+}
+
+void GetOutlineCacheStats(TTFResource* resource, uint32_t* hits, uint32_t* misses)
+{
+    *hits = (uint32_t)dmAtomicGet32(&resource->m_OutlineCache.m_Hits);
+    *misses = (uint32_t)dmAtomicGet32(&resource->m_OutlineCache.m_Misses);
+}
+
+void SetDistanceCacheSize(uint32_t size)
+{
+    g_DistanceCacheMaxSize = size;
+}
+
+void GetDistanceCacheStats(TTFResource* resource, uint32_t* hits, uint32_t* misses)
+{
+    *hits = (uint32_t)dmAtomicGet32(&resource->m_DistanceCache.m_Hits);
+    *misses = (uint32_t)dmAtomicGet32(&resource->m_DistanceCache.m_Misses);
+}
+
+uint32_t GetGlyphDistanceFieldSize(TTFResource* resource, uint32_t glyph_index, float scale, int padding)
+{
+    // The same rect as CreateDistanceField()
+    int ix0, iy0, ix1, iy1;
+    stbtt_GetGlyphBitmapBoxSubpixel(&resource->m_Font, glyph_index, scale, scale, 0.0f, 0.0f, &ix0, &iy0, &ix1, &iy1);
+    if (ix0 == ix1 || iy0 == iy1)
+        return 0;
+    return sizeof(DistanceField) + (ix1 - ix0 + 2 * padding) * (iy1 - iy0 + 2 * padding) * sizeof(float);
+}
+
+void ReserveDistanceCache(TTFResource* resource, int32_t size)
+{
+    DistanceCache* cache = &resource->m_DistanceCache;
+    DM_MUTEX_SCOPED_LOCK(cache->m_Mutex);
+    cache->m_Reserved += size;
+    if (size < 0)
+        EvictDistanceFields(cache, 0); // Back within the max size once the batch is done
+}
+
 int CodePointToGlyphIndex(TTFResource* resource, int codepoint)
 {
     return stbtt_FindGlyphIndex(&resource->m_Font, codepoint);
@@ -169,40 +528,167 @@ void GetCellSize(TTFResource* resource, uint32_t* width, uint32_t* height, uint3
     *max_ascent = resource->m_Ascent;
 }
 
-uint8_t* GenerateGlyphSdf(TTFResource* ttfresource, uint32_t glyph_index,
-                            float scale, int padding, int edge,
-                            dmGameSystem::FontGlyph* out)
+// A range of rows of a glyph, generated in parallel with the other bands
+struct SdfBandContext
+{
+    SdfShape*   m_Shape;
+    MsdfShape*  m_MsdfShape;    // Only for SDF_ALGORITHM_MSDF
+    uint8_t*    m_Out;          // The first pixel of the output image
+    float*      m_Distances;    // If set, the float distances are written here instead of m_Out (see GenerateGlyphSdfShared())
+    uint8_t*    m_Scratch;      // m_ScratchSize bytes per band, for the rows of very complex glyphs. May be 0
+    uint32_t    m_ScratchSize;
+    int         m_Channels;     // The number of channels of the output image
+    int         m_Height;
+    int         m_BandHeight;
+    uint8_t     m_Edge;
+    float       m_PixelDistScale;
+};
+
+static void GenerateSdfBand(void* _ctx, uint32_t index)
+{
+    SdfBandContext* ctx = (SdfBandContext*)_ctx;
+    int row_start = index * ctx->m_BandHeight;
+    int row_end = dmMath::Min(row_start + ctx->m_BandHeight, ctx->m_Height);
+    uint8_t* scratch = ctx->m_Scratch ? ctx->m_Scratch + index * ctx->m_ScratchSize : 0;
+
+    if (ctx->m_Distances)
+    {
+        SdfGenerateDistanceRows(ctx->m_Shape, row_start, row_end, ctx->m_Distances, scratch);
+        return;
+    }
+
+    // The sdf goes into the first channel, where the msdf reads it back for its error correction
+    SdfGenerateRows(ctx->m_Shape, row_start, row_end, ctx->m_Edge, ctx->m_PixelDistScale, ctx->m_Out, ctx->m_Channels, scratch);
+    if (ctx->m_MsdfShape)
+        SdfGenerateMsdfRows(ctx->m_MsdfShape, row_start, row_end, ctx->m_Edge, ctx->m_PixelDistScale, ctx->m_Out, scratch);
+}
+
+// The bands run on different threads, so each one gets its own slice of the scratch memory.
+// It's allocated from the arena of the job, instead of by each band
+static void AllocBandScratch(SdfBandContext* ctx, uint32_t num_bands, Arena* arena)
+{
+    uint32_t size = SdfGetRowScratchSize(ctx->m_Shape);
+    if (ctx->m_MsdfShape)
+        size = dmMath::Max(size, SdfGetMsdfRowScratchSize(ctx->m_MsdfShape));
+    ctx->m_ScratchSize = (size + 15) & ~15u; // Keeps the slices aligned
+    ctx->m_Scratch = size ? (uint8_t*)ArenaAlloc(arena, num_bands * ctx->m_ScratchSize) : 0;
+}
+
+// Large glyphs are split into bands of rows, so that they can be generated by several workers
+static uint32_t GetNumBands(const SdfParallelParams* parallel, const SdfShape* shape, int height)
+{
+    if (!parallel || parallel->m_MaxBands <= 1 || SdfGetCost(shape) < parallel->m_CostThreshold)
+        return 1;
+    return (uint32_t)dmMath::Max(1, dmMath::Min((int)parallel->m_MaxBands, height / SDF_MIN_BAND_HEIGHT));
+}
+
+// A glyph being generated, possibly over several calls to StepGlyphSdf()
+struct GlyphSdfJob
+{
+    Arena*                  m_Arena;    // Holds the job and the shapes
+    SdfBandContext          m_Bands;    // The shapes, and the output image
+    uint8_t*                m_Image;    // The image with a leading compression byte. 0 for empty glyphs, or if it failed
+    int                     m_NextRow;  // The next row to generate
+    dmGameSystem::FontGlyph m_Glyph;
+};
+
+// Sets up the sdf image with the same layout as stbtt_GetGlyphSDF(), but with an extra leading byte (the compression).
+// The image is allocated once, with num_channels channels, and the sdf is written to the first channel.
+// The msdf algorithm writes all 3 channels. The raster algorithm can't be split into rows, so it's generated right away
+static void BeginSdf(TTFResource* resource, const stbtt_fontinfo* info, uint32_t glyph_index, float scale, int padding, int edge, float pixel_dist_scale,
+                            SdfAlgorithm algorithm, int num_channels, GlyphSdfJob* job, int* width, int* height, int* ascent)
 {
+    int ix0, iy0, ix1, iy1;
+    stbtt_GetGlyphBitmapBoxSubpixel(info, glyph_index, scale, scale, 0.0f, 0.0f, &ix0, &iy0, &ix1, &iy1);
+    if (ix0 == ix1 || iy0 == iy1)
+        return;
+
+    ix0 -= padding;
+    iy0 -= padding;
+    ix1 += padding;
+    iy1 += padding;
+
+    int w = ix1 - ix0;
+    int h = iy1 - iy0;
+
+    GlyphOutline* outline = GetOutline(resource, glyph_index);
+
+    SdfShapeParams params;
+    params.m_Vertices       = outline->m_Vertices;
+    params.m_NumVertices    = outline->m_NumVertices;
+    params.m_Scale          = scale;
+    params.m_X0             = ix0;
+    params.m_Y0             = iy0;
+    params.m_Width          = w;
+    params.m_Height         = h;
+    params.m_MaxDistance    = SdfGetMaxDistance(edge, pixel_dist_scale);
+    params.m_Arena          = job->m_Arena;
+
+    if (algorithm == SDF_ALGORITHM_RASTER)
+    {
+        uint8_t* mem = (uint8_t*)malloc(w*h*num_channels + 1);
+        mem[0] = 0; // no compression
+        bool result = SdfGenerateRaster(params, edge, pixel_dist_scale, info->userdata, mem + 1, num_channels);
+        ReleaseOutline(outline);
+        if (!result)
+        {
+            free((void*)mem);
+            return;
+        }
+        job->m_Image = mem;
+        job->m_NextRow = h;
+        *width = w;
+        *height = h;
+        *ascent = -iy0;
+        return;
+    }
 
-    float pixel_dist_scale = (float)edge/(float)padding;
+    SdfBandContext& band_ctx = job->m_Bands;
+    band_ctx.m_Shape = SdfCreateShape(params);
+    if (algorithm == SDF_ALGORITHM_MSDF)
+        band_ctx.m_MsdfShape = SdfCreateMsdfShape(params);
+    ReleaseOutline(outline); // The shapes have their own copy of the outline
+
+    if (!band_ctx.m_Shape || (algorithm == SDF_ALGORITHM_MSDF && !band_ctx.m_MsdfShape))
+    {
+        SdfDeleteShape(band_ctx.m_Shape);
+        SdfDeleteMsdfShape(band_ctx.m_MsdfShape);
+        band_ctx.m_Shape = 0;
+        band_ctx.m_MsdfShape = 0;
+        return;
+    }
 
+    uint8_t* mem = (uint8_t*)malloc(w*h*num_channels + 1);
+    mem[0] = 0; // no compression
+
+    band_ctx.m_Out              = mem + 1;
+    band_ctx.m_Channels         = num_channels;
+    band_ctx.m_Height           = h;
+    band_ctx.m_BandHeight       = h;
+    band_ctx.m_Edge             = edge;
+    band_ctx.m_PixelDistScale   = pixel_dist_scale;
+    AllocBandScratch(&band_ctx, 1, job->m_Arena);
+
+    job->m_Image = mem;
+    job->m_NextRow = 0;
+    *width = w;
+    *height = h;
+    *ascent = -iy0;
+}
+
+// The metrics of a glyph, with an image of srcw*srch pixels (if has_image), see stbtt_GetGlyphSDF()
+static void GetGlyphMetrics(TTFResource* ttfresource, uint32_t glyph_index, float scale, int padding, int num_channels,
+                            bool has_image, int srcw, int srch, int ascent, dmGameSystem::FontGlyph* out)
+{
     int advx, lsb;
     stbtt_GetGlyphHMetrics(&ttfresource->m_Font, glyph_index, &advx, &lsb);
 
     int x0, y0, x1, y1;
     stbtt_GetGlyphBox(&ttfresource->m_Font, glyph_index, &x0, &y0, &x1, &y1);
 
-    int ascent = 0;
     int descent = 0;
-    int srcw = 0;
-    int srch = 0;
-    int offsetx = 0, offsety = 0;
-    uint8_t* src = stbtt_GetGlyphSDF(&ttfresource->m_Font, scale, glyph_index, padding, edge, pixel_dist_scale,
-                                        &srcw, &srch, &offsetx, &offsety);
-
-    uint8_t* mem = 0;
-    if (src)
+    if (has_image)
     {
-        uint32_t memsize = srcw*srch + 1;
-        mem = (uint8_t*)malloc(memsize);
-        memset(mem, 0, memsize);
-        uint8_t* bm = mem + 1;
-
-        memcpy(bm, src, srcw*srch);
-
-        stbtt_FreeSDF(src, 0);
-
-        ascent = -offsety;
         descent = srch - ascent;
     }
 
@@ -220,7 +706,7 @@ uint8_t* GenerateGlyphSdf(TTFResource* ttfresource, uint32_t glyph_index,
     out->m_Height = (y1 - y0) * scale;
     out->m_ImageWidth = srcw;
     out->m_ImageHeight = srch;
-    out->m_Channels = 1;
+    out->m_Channels = num_channels;
     out->m_Advance = advx*scale;;
     out->m_LeftBearing = lsb*scale;
     out->m_Ascent = ascent;
@@ -231,19 +717,190 @@ uint8_t* GenerateGlyphSdf(TTFResource* ttfresource, uint32_t glyph_index,
     //         out->m_Advance, out->m_LeftBearing,
     //         out->m_Ascent, out->m_Descent,
     //         out->m_ImageWidth, out->m_ImageHeight);
+}
+
+GlyphSdfJob* BeginGlyphSdf(TTFResource* ttfresource, uint32_t glyph_index,
+                            float scale, int padding, int spread, int edge, SdfAlgorithm algorithm,
+                            int num_channels, Arena* arena)
+{
+    GlyphSdfJob* job = (GlyphSdfJob*)ArenaAlloc(arena, sizeof(GlyphSdfJob));
+    memset(job, 0, sizeof(*job));
+    job->m_Arena = arena;
+
+    // A shallow copy, so that the stb_truetype allocations of this job go to its arena
+    stbtt_fontinfo font = ttfresource->m_Font;
+    font.userdata = arena;
+
+    float pixel_dist_scale = (float)edge/(float)spread;
+
+    int ascent = 0;
+    int srcw = 0;
+    int srch = 0;
+    if (algorithm == SDF_ALGORITHM_MSDF)
+        num_channels = 3;
+    BeginSdf(ttfresource, &font, glyph_index, scale, padding, edge, pixel_dist_scale, algorithm, num_channels, job, &srcw, &srch, &ascent);
+
+    GetGlyphMetrics(ttfresource, glyph_index, scale, padding, num_channels, job->m_Image != 0, srcw, srch, ascent, &job->m_Glyph);
+    return job;
+}
+
+bool StepGlyphSdf(GlyphSdfJob* job, uint64_t deadline)
+{
+    SdfBandContext* band_ctx = &job->m_Bands;
+    if (!band_ctx->m_Shape)
+        return true; // Empty, failed or rasterized
+
+    while (job->m_NextRow < band_ctx->m_Height)
+    {
+        // The rows are independent, so any split gives the same image as generating them all at once
+        int row = job->m_NextRow++;
+        SdfGenerateRows(band_ctx->m_Shape, row, row + 1, band_ctx->m_Edge, band_ctx->m_PixelDistScale, band_ctx->m_Out, band_ctx->m_Channels, band_ctx->m_Scratch);
+        if (band_ctx->m_MsdfShape)
+            SdfGenerateMsdfRows(band_ctx->m_MsdfShape, row, row + 1, band_ctx->m_Edge, band_ctx->m_PixelDistScale, band_ctx->m_Out, band_ctx->m_Scratch);
+
+        if (deadline && job->m_NextRow < band_ctx->m_Height && dmTime::GetTime() >= deadline)
+            return false;
+    }
+    return true;
+}
+
+uint8_t* EndGlyphSdf(GlyphSdfJob* job, dmGameSystem::FontGlyph* out)
+{
+    ArenaFree(job->m_Arena, job->m_Bands.m_Scratch);
+    SdfDeleteMsdfShape(job->m_Bands.m_MsdfShape);
+    SdfDeleteShape(job->m_Bands.m_Shape);
+
+    uint8_t* mem = job->m_Image;
+    *out = job->m_Glyph;
+    ArenaFree(job->m_Arena, job);
+    return mem;
+}
 
+uint8_t* GenerateGlyphSdf(TTFResource* ttfresource, uint32_t glyph_index,
+                            float scale, int padding, int spread, int edge, SdfAlgorithm algorithm,
+                            const SdfParallelParams* parallel, int num_channels, Arena* arena, dmGameSystem::FontGlyph* out)
+{
+    GlyphSdfJob* job = BeginGlyphSdf(ttfresource, glyph_index, scale, padding, spread, edge, algorithm, num_channels, arena);
+
+    SdfBandContext* band_ctx = &job->m_Bands;
+    uint32_t num_bands = band_ctx->m_Shape ? GetNumBands(parallel, band_ctx->m_Shape, band_ctx->m_Height) : 1;
+    if (num_bands > 1)
+    {
+        int h = band_ctx->m_Height;
+        band_ctx->m_BandHeight = (h + num_bands - 1) / num_bands;
+        num_bands = (h + band_ctx->m_BandHeight - 1) / band_ctx->m_BandHeight;
+
+        // The scratch of BeginGlyphSdf() is the last allocation, so the arena reclaims it
+        ArenaFree(arena, band_ctx->m_Scratch);
+        AllocBandScratch(band_ctx, num_bands, arena);
+        parallel->m_ParallelFor(parallel->m_Context, GenerateSdfBand, band_ctx, num_bands);
+    }
+    else
+    {
+        StepGlyphSdf(job, 0);
+    }
+
+    return EndGlyphSdf(job, out);
+}
+
+// Generates the float distance field of the glyph at the given padding. Returns 0 for empty glyphs, or if it failed
+static DistanceField* CreateDistanceField(TTFResource* ttfresource, uint32_t glyph_index, float scale, int padding, float max_distance,
+                                            const SdfParallelParams* parallel, Arena* arena)
+{
+    int ix0, iy0, ix1, iy1;
+    stbtt_GetGlyphBitmapBoxSubpixel(&ttfresource->m_Font, glyph_index, scale, scale, 0.0f, 0.0f, &ix0, &iy0, &ix1, &iy1);
+    if (ix0 == ix1 || iy0 == iy1)
+        return 0;
+
+    GlyphOutline* outline = GetOutline(ttfresource, glyph_index);
+
+    SdfShapeParams params;
+    params.m_Vertices       = outline->m_Vertices;
+    params.m_NumVertices    = outline->m_NumVertices;
+    params.m_Scale          = scale;
+    params.m_X0             = ix0 - padding;
+    params.m_Y0             = iy0 - padding;
+    params.m_Width          = ix1 - ix0 + 2 * padding;
+    params.m_Height         = iy1 - iy0 + 2 * padding;
+    params.m_MaxDistance    = max_distance;
+    params.m_Arena          = arena;
+
+    SdfShape* shape = SdfCreateShape(params);
+    ReleaseOutline(outline); // The shape has its own copy of the outline
+    if (!shape)
+        return 0;
+
+    DistanceField* field = (DistanceField*)malloc(sizeof(DistanceField));
+    field->m_Distances      = (float*)malloc(params.m_Width * params.m_Height * sizeof(float));
+    field->m_GlyphIndex     = glyph_index;
+    field->m_Scale          = scale;
+    field->m_Padding        = padding;
+    field->m_MaxDistance    = max_distance;
+    field->m_X0             = params.m_X0;
+    field->m_Y0             = params.m_Y0;
+    field->m_Width          = params.m_Width;
+    field->m_Height         = params.m_Height;
+    field->m_LastUsed       = 0;
+    field->m_RefCount       = 1;
+
+    SdfBandContext band_ctx;
+    memset(&band_ctx, 0, sizeof(band_ctx));
+    band_ctx.m_Shape        = shape;
+    band_ctx.m_Distances    = field->m_Distances;
+    band_ctx.m_Height       = params.m_Height;
+    band_ctx.m_BandHeight   = params.m_Height;
+
+    uint32_t num_bands = GetNumBands(parallel, shape, params.m_Height);
+    if (num_bands > 1)
+    {
+        int h = params.m_Height;
+        band_ctx.m_BandHeight = (h + num_bands - 1) / num_bands;
+        num_bands = (h + band_ctx.m_BandHeight - 1) / band_ctx.m_BandHeight;
+    }
+
+    AllocBandScratch(&band_ctx, num_bands, arena);
+    if (num_bands > 1)
+        parallel->m_ParallelFor(parallel->m_Context, GenerateSdfBand, &band_ctx, num_bands);
+    else
+        GenerateSdfBand(&band_ctx, 0);
+
+    ArenaFree(arena, band_ctx.m_Scratch);
+    SdfDeleteShape(shape);
+    return field;
+}
+
+uint8_t* GenerateGlyphSdfShared(TTFResource* ttfresource, uint32_t glyph_index,
+                            float scale, int padding, int spread, int edge, int shared_padding, float shared_max_distance,
+                            const SdfParallelParams* parallel, int num_channels, Arena* arena, dmGameSystem::FontGlyph* out)
+{
+    float pixel_dist_scale = (float)edge/(float)spread;
+    float max_distance = SdfGetMaxDistance(edge, pixel_dist_scale);
+
+    // Any field that covers this font's padding and distance range gives the same image
+    DistanceField* field = GetDistanceField(ttfresource, glyph_index, scale, padding, max_distance);
+    if (!field)
+    {
+        shared_padding = dmMath::Max(shared_padding, padding);
+        shared_max_distance = dmMath::Max(shared_max_distance, max_distance);
+        field = CreateDistanceField(ttfresource, glyph_index, scale, shared_padding, shared_max_distance, parallel, arena);
+        if (!field) // Empty glyphs have no image, but still need their metrics
+            return GenerateGlyphSdf(ttfresource, glyph_index, scale, padding, spread, edge, SDF_ALGORITHM_ANALYTIC, parallel, num_channels, arena, out);
+        PutDistanceField(ttfresource, glyph_index, field);
+    }
 
-    //printf("  box: p0: %f, %f p1: %f, %f\n", x0 * scale, y0 * scale, x1 * scale, y1 * scale);
-    //printf("  offset: %d, %d \n", offsetx, offsety);
+    // The image is the center of the field, as the glyph box is the same for all paddings
+    int border = field->m_Padding - padding;
+    int w = field->m_Width - 2 * border;
+    int h = field->m_Height - 2 * border;
 
-    // int gi_T = dmFontGen::CodePointToGlyphIndex(ttfresource, 'T');
-    // int gi_h = dmFontGen::CodePointToGlyphIndex(ttfresource, 'h');
-    // // int debug = glyph_index == 77 || glyph_index == 75;
-    // int debug = glyph_index == gi_T || glyph_index == gi_h;
+    uint8_t* mem = (uint8_t*)malloc(w*h*num_channels + 1);
+    mem[0] = 0; // no compression
+    SdfQuantizeDistances(field->m_Distances, field->m_Width, border, border, w, h, edge, pixel_dist_scale, mem + 1, num_channels);
 
-    // if (debug)
-    //     DebugPrintBitmap((mem+1), srcw, srch);
+    int ascent = -(field->m_Y0 + border);
+    ReleaseDistanceField(field);
 
+    GetGlyphMetrics(ttfresource, glyph_index, scale, padding, num_channels, true, w, h, ascent, out);
     return mem;
 }
 
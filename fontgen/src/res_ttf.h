@@ -2,13 +2,67 @@
 
 #include <stdint.h>
 #include <dmsdk/gamesys/resources/res_font.h>
+#include "sdf.h" // SdfAlgorithm
 
 namespace dmFontGen
 {
     struct TTFResource;
+    struct Arena;
+
+    typedef void (*FParallelProcess)(void* process_ctx, uint32_t index);
+
+    /*
+     * Calls process for each index in [0, count), possibly in parallel. Returns when all calls are done
+     */
+    typedef void (*FParallelFor)(void* ctx, FParallelProcess process, void* process_ctx, uint32_t count);
+
+    struct SdfParallelParams
+    {
+        FParallelFor    m_ParallelFor;
+        void*           m_Context;
+        uint32_t        m_MaxBands;         // The max number of row bands to split a glyph into (e.g. the number of workers)
+        uint64_t        m_CostThreshold;    // Glyphs with a cost (pixels * segments) below this aren't split
+    };
 
     const char* GetFontPath(TTFResource* resource);
 
+    /*
+     * Gets the hash of the ttf file contents
+     */
+    uint64_t GetFontDataHash(TTFResource* resource);
+
+    /*
+     * Sets the max size (bytes) of the decoded glyph outline cache of each ttf resource
+     */
+    void SetOutlineCacheSize(uint32_t size);
+
+    /*
+     * Gets the number of outline cache hits and misses since the resource was loaded
+     */
+    void GetOutlineCacheStats(TTFResource* resource, uint32_t* hits, uint32_t* misses);
+
+    /*
+     * Sets the max size (bytes) of the float distance field cache of each ttf resource (see GenerateGlyphSdfShared())
+     */
+    void SetDistanceCacheSize(uint32_t size);
+
+    /*
+     * Gets the number of distance field cache hits and misses since the resource was loaded
+     */
+    void GetDistanceCacheStats(TTFResource* resource, uint32_t* hits, uint32_t* misses);
+
+    /*
+     * Gets the size (bytes) a glyph takes in the distance field cache, when generated with the given padding. 0 for empty glyphs
+     */
+    uint32_t GetGlyphDistanceFieldSize(TTFResource* resource, uint32_t glyph_index, float scale, int padding);
+
+    /*
+     * Grows the distance field cache of the resource by size bytes, or shrinks it back with a negative size.
+     * The fonts sharing the fields queue their glyphs one font after the other, so the cache must hold the fields of a whole
+     * batch until the other fonts have used them
+     */
+    void ReserveDistanceCache(TTFResource* resource, int32_t size);
+
     /*
      *
      */
@@ -35,9 +89,41 @@ namespace dmFontGen
     void GetCellSize(TTFResource* resource, uint32_t* width, uint32_t* height, uint32_t* max_ascent);
 
     /*
-     *
+     * Generates the sdf image of a glyph, using the given algorithm (see sdf.h)
+     * The image has padding pixels around the glyph. The distances are encoded so that the edge value is on the outline,
+     * and 0 is spread pixels outside of it. The spread is usually the padding, but a larger spread fits a wider distance range
+     * (e.g. an outline) into the same padding.
+     * If parallel is non zero, large glyphs are generated in parallel (not for SDF_ALGORITHM_RASTER)
+     * The image is allocated once with num_channels channels (at least 3 for SDF_ALGORITHM_MSDF), and a leading compression byte.
+     * The sdf is written to the first channel, and any other channels are left uninitialized for the caller to fill in.
+     * The stb_truetype and sdf scratch memory is allocated from the arena (may be 0), which the caller resets after the job
      */
     uint8_t* GenerateGlyphSdf(TTFResource* font, uint32_t glyph_index,
-                            float scale, int padding, int edge,
-                            dmGameSystem::FontGlyph* glyph);
+                            float scale, int padding, int spread, int edge, SdfAlgorithm algorithm,
+                            const SdfParallelParams* parallel, int num_channels, Arena* arena, dmGameSystem::FontGlyph* glyph);
+
+    /*
+     * Like GenerateGlyphSdf() with SDF_ALGORITHM_ANALYTIC, for fonts that share the ttf and scale, but differ in padding, spread, edge or channels.
+     * The float distance field is generated once with shared_padding (the largest padding of the fonts), and shared_max_distance
+     * (the largest max distance, see SdfGetMaxDistance()). It's kept in a small cache in the ttf resource, and each font quantizes its
+     * own image from it. The output is the same as from GenerateGlyphSdf()
+     */
+    uint8_t* GenerateGlyphSdfShared(TTFResource* font, uint32_t glyph_index,
+                            float scale, int padding, int spread, int edge, int shared_padding, float shared_max_distance,
+                            const SdfParallelParams* parallel, int num_channels, Arena* arena, dmGameSystem::FontGlyph* glyph);
+
+    /*
+     * Resumable generation, for platforms without threads, where a large glyph may take longer than a frame.
+     * BeginGlyphSdf() takes the same arguments as GenerateGlyphSdf(). The job and its shapes live in the arena, so it must not be reset before EndGlyphSdf().
+     * StepGlyphSdf() generates rows until the deadline (dmTime::GetTime(), 0 means no deadline) and returns true when all rows are done.
+     * EndGlyphSdf() deletes the job, and returns the image (may be 0) and glyph info, just like GenerateGlyphSdf().
+     * It may be called before all rows are done, to abort the generation
+     */
+    struct GlyphSdfJob;
+
+    GlyphSdfJob* BeginGlyphSdf(TTFResource* font, uint32_t glyph_index,
+                            float scale, int padding, int spread, int edge, SdfAlgorithm algorithm,
+                            int num_channels, Arena* arena);
+    bool         StepGlyphSdf(GlyphSdfJob* job, uint64_t deadline);
+    uint8_t*     EndGlyphSdf(GlyphSdfJob* job, dmGameSystem::FontGlyph* glyph);
 }
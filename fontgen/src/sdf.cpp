@@ -0,0 +1,885 @@
+// The signed distance field generator
+//
+// The math is a port of stbtt_GetGlyphSDF(), but instead of testing every pixel against
+// every segment of the outline, the segments are first put into a uniform grid.
+// Each grid cell lists the segments whose bounding box (expanded by the max distance) overlaps the cell,
+// and each pixel only evaluates the segments of its cell.
+//
+// Distances larger than the max distance saturate the 8 bit output, so culling those segments
+// doesn't change the result. The distance to each candidate segment is calculated exactly as stb does it,
+// so the output is identical to stbtt_GetGlyphSDF(), apart from float rounding in the order of evaluation,
+// which may make a pixel differ by at most 1.
+//
+// The inside/outside test intersects each row with the outline once, instead of casting a ray per pixel.
+// It sums the same signed (nonzero) windings as stb, so the sign of every pixel is unchanged. Overlapping contours
+// still give the same image as stb, where the edges inside the overlap pull the distance towards the edge value.
+//
+// Differences to stbtt_GetGlyphSDF():
+//   * Cubic segments (CFF fonts) are flattened into lines. stb ignores them altogether.
+
+#include "sdf.h"
+#include "sdf_private.h"
+#include "arena.h"
+
+#include <stdlib.h> // malloc
+#include <string.h> // memset
+#include <math.h>
+
+namespace dmFontGen
+{
+
+static inline float Min3(float a, float b, float c)
+{
+    float m = a < b ? a : b;
+    return m < c ? m : c;
+}
+
+static inline float Max3(float a, float b, float c)
+{
+    float m = a > b ? a : b;
+    return m > c ? m : c;
+}
+
+// ****************************************************************************************************
+// Kernel selection
+
+static SdfKernel GetBestKernel()
+{
+#if defined(FONTGEN_SDF_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return SDF_KERNEL_AVX2;
+#endif
+#if defined(FONTGEN_SDF_SSE2)
+    return SDF_KERNEL_SSE2;
+#elif defined(FONTGEN_SDF_NEON)
+    return SDF_KERNEL_NEON;
+#else
+    return SDF_KERNEL_SCALAR;
+#endif
+}
+
+static SdfKernel g_Kernel = GetBestKernel();
+
+static FSdfDistanceKernel GetKernelFunction(SdfKernel kernel)
+{
+    switch(kernel)
+    {
+#if defined(FONTGEN_SDF_SSE2)
+    case SDF_KERNEL_SSE2:   return SdfDistanceKernelSSE2;
+#endif
+#if defined(FONTGEN_SDF_AVX2)
+    case SDF_KERNEL_AVX2:   return SdfDistanceKernelAVX2;
+#endif
+#if defined(FONTGEN_SDF_NEON)
+    case SDF_KERNEL_NEON:   return SdfDistanceKernelNEON;
+#endif
+    default:                return SdfDistanceKernelScalar;
+    }
+}
+
+bool SdfSetKernel(SdfKernel kernel)
+{
+    if (kernel == SDF_KERNEL_AUTO)
+        kernel = GetBestKernel();
+
+    bool supported = kernel == SDF_KERNEL_SCALAR;
+#if defined(FONTGEN_SDF_SSE2)
+    supported |= kernel == SDF_KERNEL_SSE2;
+#endif
+#if defined(FONTGEN_SDF_AVX2)
+    supported |= kernel == SDF_KERNEL_AVX2 && __builtin_cpu_supports("avx2");
+#endif
+#if defined(FONTGEN_SDF_NEON)
+    supported |= kernel == SDF_KERNEL_NEON;
+#endif
+    if (supported)
+        g_Kernel = kernel;
+    return supported;
+}
+
+SdfKernel SdfGetKernel()
+{
+    return g_Kernel;
+}
+
+// ****************************************************************************************************
+// Outline
+
+static void AddSegment(SdfShape* shape, int type, float scale, const float* gx, const float* gy)
+{
+    // see stbtt_GetGlyphSDF
+    const float eps = 1./1024, eps2 = eps*eps;
+    float scale_x = scale;
+    float scale_y = -scale; // invert for y-downwards bitmaps
+
+    SdfSegment* seg = &shape->m_Segments[shape->m_NumSegments++];
+    memset(seg, 0, sizeof(*seg));
+    seg->m_Type = (uint8_t)type;
+    seg->m_GX0 = gx[0]; seg->m_GY0 = gy[0];
+    seg->m_GX1 = gx[1]; seg->m_GY1 = gy[1];
+
+    if (type == SDF_SEGMENT_LINE)
+    {
+        float x0 = gx[1]*scale_x, y0 = gy[1]*scale_y;
+        float x1 = gx[0]*scale_x, y1 = gy[0]*scale_y;
+        float dist = (float) sqrt((x1-x0)*(x1-x0) + (y1-y0)*(y1-y0));
+        if (dist < eps)
+            return; // Degenerate lines are skipped by the distance kernels
+
+        SdfLines& lines = shape->m_Lines;
+        uint32_t i = lines.m_Count++;
+        lines.m_X0[i] = x0;
+        lines.m_Y0[i] = y0;
+        lines.m_X1[i] = x1;
+        lines.m_Y1[i] = y1;
+        lines.m_InvLength[i] = 1.0f / dist;
+    }
+    else
+    {
+        seg->m_GX2 = gx[2]; seg->m_GY2 = gy[2];
+
+        float x2 = gx[0]*scale_x, y2 = gy[0]*scale_y;
+        float x1 = gx[1]*scale_x, y1 = gy[1]*scale_y;
+        float x0 = gx[2]*scale_x, y0 = gy[2]*scale_y;
+        float bx = x0 - 2*x1 + x2, by = y0 - 2*y1 + y2;
+        float len2 = bx*bx + by*by;
+
+        SdfQuads& quads = shape->m_Quads;
+        uint32_t i = quads.m_Count++;
+        quads.m_X0[i] = x0;
+        quads.m_Y0[i] = y0;
+        quads.m_X1[i] = x1;
+        quads.m_Y1[i] = y1;
+        quads.m_X2[i] = x2;
+        quads.m_Y2[i] = y2;
+        quads.m_InvA[i] = (len2 >= eps2) ? 1.0f / len2 : 0.0f;
+        quads.m_MinX[i] = Min3(x0,x1,x2);
+        quads.m_MinY[i] = Min3(y0,y1,y2);
+        quads.m_MaxX[i] = Max3(x0,x1,x2);
+        quads.m_MaxY[i] = Max3(y0,y1,y2);
+    }
+}
+
+static void CountSegments(const stbtt_vertex* verts, int num_verts, int* num_lines, int* num_quads)
+{
+    *num_lines = 0;
+    *num_quads = 0;
+    for (int i = 0; i < num_verts; ++i)
+    {
+        if (verts[i].type == STBTT_vline)
+            *num_lines += 1;
+        else if (verts[i].type == STBTT_vcurve)
+            *num_quads += 1;
+        else if (verts[i].type == STBTT_vcubic)
+            *num_lines += SDF_CUBIC_SUBDIVISIONS;
+    }
+}
+
+static void AddSegments(SdfShape* shape, const stbtt_vertex* verts, int num_verts, float scale)
+{
+    for (int i = 1; i < num_verts; ++i)
+    {
+        const stbtt_vertex& prev = verts[i-1];
+        const stbtt_vertex& v = verts[i];
+        if (v.type == STBTT_vline)
+        {
+            float gx[2] = { (float)prev.x, (float)v.x };
+            float gy[2] = { (float)prev.y, (float)v.y };
+            AddSegment(shape, SDF_SEGMENT_LINE, scale, gx, gy);
+        }
+        else if (v.type == STBTT_vcurve)
+        {
+            float gx[3] = { (float)prev.x, (float)v.cx, (float)v.x };
+            float gy[3] = { (float)prev.y, (float)v.cy, (float)v.y };
+            AddSegment(shape, SDF_SEGMENT_QUAD, scale, gx, gy);
+        }
+        else if (v.type == STBTT_vcubic)
+        {
+            float px = prev.x, py = prev.y;
+            for (int s = 1; s <= SDF_CUBIC_SUBDIVISIONS; ++s)
+            {
+                float t = s / (float)SDF_CUBIC_SUBDIVISIONS;
+                float it = 1.0f - t;
+                float x = it*it*it*prev.x + 3*it*it*t*v.cx + 3*it*t*t*v.cx1 + t*t*t*v.x;
+                float y = it*it*it*prev.y + 3*it*it*t*v.cy + 3*it*t*t*v.cy1 + t*t*t*v.y;
+                float gx[2] = { px, x };
+                float gy[2] = { py, y };
+                AddSegment(shape, SDF_SEGMENT_LINE, scale, gx, gy);
+                px = x;
+                py = y;
+            }
+        }
+    }
+}
+
+// ****************************************************************************************************
+// Grid
+
+// Gets the range of cells whose pixel centers are within the bounds. Returns false if no cells overlap
+static bool GetCellRange(const SdfShape* shape, float minx, float miny, float maxx, float maxy,
+                            int* cx0, int* cy0, int* cx1, int* cy1)
+{
+    // Pixel x has its center at x + 0.5
+    float fx0 = floorf((minx - shape->m_X0 - 0.5f) / SDF_CELL_SIZE);
+    float fx1 = floorf((maxx - shape->m_X0 - 0.5f) / SDF_CELL_SIZE);
+    float fy0 = floorf((miny - shape->m_Y0 - 0.5f) / SDF_CELL_SIZE);
+    float fy1 = floorf((maxy - shape->m_Y0 - 0.5f) / SDF_CELL_SIZE);
+    if (fx1 < 0 || fy1 < 0 || fx0 >= shape->m_CellsX || fy0 >= shape->m_CellsY)
+        return false;
+
+    *cx0 = fx0 < 0 ? 0 : (int)fx0;
+    *cy0 = fy0 < 0 ? 0 : (int)fy0;
+    *cx1 = fx1 >= shape->m_CellsX ? shape->m_CellsX - 1 : (int)fx1;
+    *cy1 = fy1 >= shape->m_CellsY ? shape->m_CellsY - 1 : (int)fy1;
+    return true;
+}
+
+// Puts each item into the cells overlapped by its bounding box (expanded by max_distance)
+static void BuildGrid(SdfShape* shape, SdfGrid* grid, uint32_t count,
+                        const float* minx, const float* miny, const float* maxx, const float* maxy, float max_distance)
+{
+    int num_cells = shape->m_CellsX * shape->m_CellsY;
+
+    grid->m_CellStart = (uint32_t*)ArenaAlloc(shape->m_Arena, (num_cells + 1) * sizeof(uint32_t));
+    memset(grid->m_CellStart, 0, (num_cells + 1) * sizeof(uint32_t));
+
+    // First pass counts the items per cell, the second pass fills in the indices
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            int cx0, cy0, cx1, cy1;
+            if (!GetCellRange(shape, minx[i] - max_distance, miny[i] - max_distance, maxx[i] + max_distance, maxy[i] + max_distance, &cx0, &cy0, &cx1, &cy1))
+                continue;
+
+            for (int cy = cy0; cy <= cy1; ++cy)
+            {
+                for (int cx = cx0; cx <= cx1; ++cx)
+                {
+                    int cell = cy * shape->m_CellsX + cx;
+                    if (pass == 0)
+                        grid->m_CellStart[cell + 1]++;
+                    else
+                        grid->m_Indices[grid->m_CellStart[cell]++] = (uint16_t)i;
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            for (int c = 0; c < num_cells; ++c)
+                grid->m_CellStart[c + 1] += grid->m_CellStart[c];
+            uint32_t total = grid->m_CellStart[num_cells];
+            grid->m_Indices = (uint16_t*)ArenaAlloc(shape->m_Arena, (total > 0 ? total : 1) * sizeof(uint16_t));
+        }
+        else
+        {
+            // The fill pass moved each start to the end of its range, shift them back
+            for (int c = num_cells; c > 0; --c)
+                grid->m_CellStart[c] = grid->m_CellStart[c - 1];
+            grid->m_CellStart[0] = 0;
+        }
+    }
+}
+
+static void BuildGrids(SdfShape* shape, float max_distance)
+{
+    shape->m_CellsX = (shape->m_Width + SDF_CELL_SIZE - 1) / SDF_CELL_SIZE;
+    shape->m_CellsY = (shape->m_Height + SDF_CELL_SIZE - 1) / SDF_CELL_SIZE;
+
+    // The lines have no precalculated bounding box
+    const SdfLines& lines = shape->m_Lines;
+    float* bounds = (float*)ArenaAlloc(shape->m_Arena, (lines.m_Count > 0 ? lines.m_Count : 1) * 4 * sizeof(float));
+    float* minx = bounds;
+    float* miny = bounds + lines.m_Count;
+    float* maxx = bounds + lines.m_Count * 2;
+    float* maxy = bounds + lines.m_Count * 3;
+    for (uint32_t i = 0; i < lines.m_Count; ++i)
+    {
+        minx[i] = lines.m_X0[i] < lines.m_X1[i] ? lines.m_X0[i] : lines.m_X1[i];
+        maxx[i] = lines.m_X0[i] > lines.m_X1[i] ? lines.m_X0[i] : lines.m_X1[i];
+        miny[i] = lines.m_Y0[i] < lines.m_Y1[i] ? lines.m_Y0[i] : lines.m_Y1[i];
+        maxy[i] = lines.m_Y0[i] > lines.m_Y1[i] ? lines.m_Y0[i] : lines.m_Y1[i];
+    }
+    BuildGrid(shape, &shape->m_LineGrid, lines.m_Count, minx, miny, maxx, maxy, max_distance);
+    ArenaFree(shape->m_Arena, bounds);
+
+    const SdfQuads& quads = shape->m_Quads;
+    BuildGrid(shape, &shape->m_QuadGrid, quads.m_Count, quads.m_MinX, quads.m_MinY, quads.m_MaxX, quads.m_MaxY, max_distance);
+}
+
+SdfShape* SdfCreateShape(const SdfShapeParams& params)
+{
+    if (params.m_Scale == 0 || params.m_Width <= 0 || params.m_Height <= 0)
+        return 0;
+
+    int num_lines, num_quads;
+    CountSegments(params.m_Vertices, params.m_NumVertices, &num_lines, &num_quads);
+    if (num_lines > 0xFFFF || num_quads > 0xFFFF) // The grid uses 16 bit indices
+        return 0;
+
+    SdfShape* shape = (SdfShape*)ArenaAlloc(params.m_Arena, sizeof(SdfShape));
+    memset(shape, 0, sizeof(*shape));
+    shape->m_Arena  = params.m_Arena;
+    shape->m_Scale  = params.m_Scale;
+    shape->m_X0     = params.m_X0;
+    shape->m_Y0     = params.m_Y0;
+    shape->m_Width  = params.m_Width;
+    shape->m_Height = params.m_Height;
+    shape->m_Kernel = GetKernelFunction(g_Kernel);
+
+    shape->m_Segments = (SdfSegment*)ArenaAlloc(shape->m_Arena, (num_lines + num_quads + 1) * sizeof(SdfSegment));
+
+    shape->m_Floats = (float*)ArenaAlloc(shape->m_Arena, (num_lines * 5 + num_quads * 11 + 1) * sizeof(float));
+    float* f = shape->m_Floats;
+    SdfLines& lines = shape->m_Lines;
+    lines.m_X0 = f; f += num_lines;
+    lines.m_Y0 = f; f += num_lines;
+    lines.m_X1 = f; f += num_lines;
+    lines.m_Y1 = f; f += num_lines;
+    lines.m_InvLength = f; f += num_lines;
+    SdfQuads& quads = shape->m_Quads;
+    quads.m_X0 = f; f += num_quads;
+    quads.m_Y0 = f; f += num_quads;
+    quads.m_X1 = f; f += num_quads;
+    quads.m_Y1 = f; f += num_quads;
+    quads.m_X2 = f; f += num_quads;
+    quads.m_Y2 = f; f += num_quads;
+    quads.m_InvA = f; f += num_quads;
+    quads.m_MinX = f; f += num_quads;
+    quads.m_MinY = f; f += num_quads;
+    quads.m_MaxX = f; f += num_quads;
+    quads.m_MaxY = f; f += num_quads;
+
+    AddSegments(shape, params.m_Vertices, params.m_NumVertices, params.m_Scale);
+
+    BuildGrids(shape, params.m_MaxDistance);
+    return shape;
+}
+
+void SdfDeleteShape(SdfShape* shape)
+{
+    if (!shape)
+        return;
+    // In reverse order, so that the arena can reclaim the memory
+    Arena* arena = shape->m_Arena;
+    ArenaFree(arena, shape->m_QuadGrid.m_Indices);
+    ArenaFree(arena, shape->m_QuadGrid.m_CellStart);
+    ArenaFree(arena, shape->m_LineGrid.m_Indices);
+    ArenaFree(arena, shape->m_LineGrid.m_CellStart);
+    ArenaFree(arena, shape->m_Floats);
+    ArenaFree(arena, shape->m_Segments);
+    ArenaFree(arena, shape);
+}
+
+uint64_t SdfGetCost(const SdfShape* shape)
+{
+    return (uint64_t)shape->m_Width * shape->m_Height * (shape->m_NumSegments > 0 ? shape->m_NumSegments : 1);
+}
+
+float SdfGetMaxDistance(uint8_t edge, float pixel_dist_scale)
+{
+    if (pixel_dist_scale <= 0.0f)
+        return 0.0f;
+    int range = edge > (255 - edge) ? edge : (255 - edge);
+    return range / pixel_dist_scale + 1.0f; // add a margin for rounding errors
+}
+
+// ****************************************************************************************************
+// Inside/outside test (see stbtt__compute_crossings_x)
+
+static int RayIntersectBezier(float orig[2], float ray[2], float q0[2], float q1[2], float q2[2], float hits[2][2])
+{
+    float q0perp = q0[1]*ray[0] - q0[0]*ray[1];
+    float q1perp = q1[1]*ray[0] - q1[0]*ray[1];
+    float q2perp = q2[1]*ray[0] - q2[0]*ray[1];
+    float roperp = orig[1]*ray[0] - orig[0]*ray[1];
+
+    float a = q0perp - 2*q1perp + q2perp;
+    float b = q1perp - q0perp;
+    float c = q0perp - roperp;
+
+    float s0 = 0., s1 = 0.;
+    int num_s = 0;
+
+    if (a != 0.0)
+    {
+        float discr = b*b - a*c;
+        if (discr > 0.0)
+        {
+            float rcpna = -1 / a;
+            float d = (float) sqrt(discr);
+            s0 = (b+d) * rcpna;
+            s1 = (b-d) * rcpna;
+            if (s0 >= 0.0 && s0 <= 1.0)
+                num_s = 1;
+            if (d > 0.0 && s1 >= 0.0 && s1 <= 1.0)
+            {
+                if (num_s == 0) s0 = s1;
+                ++num_s;
+            }
+        }
+    }
+    else
+    {
+        // 2*b*s + c = 0
+        // s = -c / (2*b)
+        s0 = c / (-2 * b);
+        if (s0 >= 0.0 && s0 <= 1.0)
+            num_s = 1;
+    }
+
+    if (num_s == 0)
+        return 0;
+
+    float rcp_len2 = 1 / (ray[0]*ray[0] + ray[1]*ray[1]);
+    float rayn_x = ray[0] * rcp_len2, rayn_y = ray[1] * rcp_len2;
+
+    float q0d =   q0[0]*rayn_x +   q0[1]*rayn_y;
+    float q1d =   q1[0]*rayn_x +   q1[1]*rayn_y;
+    float q2d =   q2[0]*rayn_x +   q2[1]*rayn_y;
+    float rod = orig[0]*rayn_x + orig[1]*rayn_y;
+
+    float q10d = q1d - q0d;
+    float q20d = q2d - q0d;
+    float q0rd = q0d - rod;
+
+    hits[0][0] = q0rd + s0*(2.0f - 2.0f*s0)*q10d + s0*s0*q20d;
+    hits[0][1] = a*s0+b;
+
+    if (num_s > 1)
+    {
+        hits[1][0] = q0rd + s1*(2.0f - 2.0f*s1)*q10d + s1*s1*q20d;
+        hits[1][1] = a*s1+b;
+        return 2;
+    }
+    return 1;
+}
+
+// A row crossing. Pixels to the right of m_X get m_Winding added to their winding number
+struct SdfCrossing
+{
+    float   m_X;
+    int     m_Winding;
+};
+
+static const int SDF_STACK_CROSSINGS = 1024;
+
+// A pixel at x is crossed by the line if x > min(x0, x1) and x > x_inter
+static inline int LineCrossing(float y, float fx0, float fy0, float fx1, float fy1, SdfCrossing* crossing)
+{
+    int x0 = (int)fx0, y0 = (int)fy0;
+    int x1 = (int)fx1, y1 = (int)fy1;
+    if (y > (y0 < y1 ? y0 : y1) && y < (y0 > y1 ? y0 : y1))
+    {
+        float x_inter = (y - y0) / (y1 - y0) * (x1-x0) + x0;
+        float x_min = (float)(x0 < x1 ? x0 : x1);
+        crossing->m_X = x_inter > x_min ? x_inter : x_min;
+        crossing->m_Winding = (y0 < y1) ? 1 : -1;
+        return 1;
+    }
+    return 0;
+}
+
+// Intersects the row with the outline (glyph space), and returns the crossings sorted on x.
+// The winding number of a pixel is then the sum of the crossings to its left, which is
+// the same as stbtt__compute_crossings_x() calculates with a ray per pixel.
+static int ComputeRowCrossings(const SdfShape* shape, float y, SdfCrossing* crossings)
+{
+    float orig[2] = { 0, y };
+    float ray[2] = { 1, 0 };
+    int num_crossings = 0;
+
+    for (int i = 0; i < shape->m_NumSegments; ++i)
+    {
+        const SdfSegment* seg = &shape->m_Segments[i];
+        if (seg->m_Type == SDF_SEGMENT_LINE)
+        {
+            num_crossings += LineCrossing(y, seg->m_GX0, seg->m_GY0, seg->m_GX1, seg->m_GY1, &crossings[num_crossings]);
+            continue;
+        }
+
+        float q0[2] = { (float)(int)seg->m_GX0, (float)(int)seg->m_GY0 };
+        float q1[2] = { (float)(int)seg->m_GX1, (float)(int)seg->m_GY1 };
+        float q2[2] = { (float)(int)seg->m_GX2, (float)(int)seg->m_GY2 };
+        if (!(y > Min3(q0[1], q1[1], q2[1]) && y < Max3(q0[1], q1[1], q2[1])))
+            continue;
+
+        if ((q0[0] == q1[0] && q0[1] == q1[1]) || (q1[0] == q2[0] && q1[1] == q2[1]))
+        {
+            num_crossings += LineCrossing(y, seg->m_GX0, seg->m_GY0, seg->m_GX2, seg->m_GY2, &crossings[num_crossings]);
+        }
+        else
+        {
+            float x_min = Min3(q0[0], q1[0], q2[0]);
+            float hits[2][2];
+            int num_hits = RayIntersectBezier(orig, ray, q0, q1, q2, hits);
+            for (int h = 0; h < num_hits; ++h)
+            {
+                SdfCrossing* crossing = &crossings[num_crossings++];
+                crossing->m_X = hits[h][0] > x_min ? hits[h][0] : x_min;
+                crossing->m_Winding = hits[h][1] < 0 ? -1 : 1;
+            }
+        }
+    }
+
+    // Insertion sort, there are usually only a handful of crossings
+    for (int i = 1; i < num_crossings; ++i)
+    {
+        SdfCrossing c = crossings[i];
+        int j = i - 1;
+        for (; j >= 0 && crossings[j].m_X > c.m_X; --j)
+            crossings[j+1] = crossings[j];
+        crossings[j+1] = c;
+    }
+    return num_crossings;
+}
+
+// ****************************************************************************************************
+// Distance (see stbtt_GetGlyphSDF)
+
+static float cuberoot(float x)
+{
+    if (x<0)
+        return -(float) pow(-x,1.0f/3.0f);
+    else
+        return  (float) pow( x,1.0f/3.0f);
+}
+
+// x^3 + a*x^2 + b*x + c = 0
+int SdfSolveCubic(float a, float b, float c, float* r)
+{
+    float s = -a / 3;
+    float p = b - a*a / 3;
+    float q = a * (2*a*a - 9*b) / 27 + c;
+    float p3 = p*p*p;
+    float d = q*q + 4*p3 / 27;
+    if (d >= 0)
+    {
+        float z = (float) sqrt(d);
+        float u = (-q + z) / 2;
+        float v = (-q - z) / 2;
+        u = cuberoot(u);
+        v = cuberoot(v);
+        r[0] = s + u + v;
+        return 1;
+    }
+    else
+    {
+        float u = (float) sqrt(-p/3);
+        float v = (float) acos(-sqrt(-27/p3) * q / 2) / 3; // p3 must be negative, since d is negative
+        float m = (float) cos(v);
+        float n = (float) cos(v-3.141592/2)*1.732050808f;
+        r[0] = s + u * 2 * m;
+        r[1] = s - u * (m + n);
+        r[2] = s - u * (m - n);
+        return 3;
+    }
+}
+
+static inline float LineDistance(const SdfLines& lines, uint32_t i, float sx, float sy, float min_dist)
+{
+    float x0 = lines.m_X0[i], y0 = lines.m_Y0[i];
+    float x1 = lines.m_X1[i], y1 = lines.m_Y1[i];
+
+    float dist,dist2 = (x0-sx)*(x0-sx) + (y0-sy)*(y0-sy);
+    if (dist2 < min_dist*min_dist)
+        min_dist = (float) sqrt(dist2);
+
+    dist = (float) fabs((x1-x0)*(y0-sy) - (y1-y0)*(x0-sx)) * lines.m_InvLength[i];
+    if (dist < min_dist)
+    {
+        // check position along line
+        float dx = x1-x0, dy = y1-y0;
+        float px = x0-sx, py = y0-sy;
+        float t = -(px*dx + py*dy) / (dx*dx + dy*dy);
+        if (t >= 0.0f && t <= 1.0f)
+            min_dist = dist;
+    }
+    return min_dist;
+}
+
+static inline float QuadDistance(const SdfQuads& quads, uint32_t i, float sx, float sy, float min_dist)
+{
+    const float eps = 1./1024, eps2 = eps*eps;
+
+    // coarse culling against bbox to avoid computing cubic unnecessarily
+    if (!(sx > quads.m_MinX[i]-min_dist && sx < quads.m_MaxX[i]+min_dist && sy > quads.m_MinY[i]-min_dist && sy < quads.m_MaxY[i]+min_dist))
+        return min_dist;
+
+    float x0 = quads.m_X0[i], y0 = quads.m_Y0[i];
+    float x1 = quads.m_X1[i], y1 = quads.m_Y1[i];
+    float x2 = quads.m_X2[i], y2 = quads.m_Y2[i];
+
+    int num=0;
+    float ax = x1-x0, ay = y1-y0;
+    float bx = x0 - 2*x1 + x2, by = y0 - 2*y1 + y2;
+    float mx = x0 - sx, my = y0 - sy;
+    float res[3] = {0.f,0.f,0.f};
+    float px,py,t,it,dist2;
+    float a_inv = quads.m_InvA[i];
+    if (a_inv == 0.0) // if a_inv is 0, it's 2nd degree so use quadratic formula
+    {
+        float a = 3*(ax*bx + ay*by);
+        float b = 2*(ax*ax + ay*ay) + (mx*bx+my*by);
+        float c = mx*ax+my*ay;
+        if (fabs(a) < eps2) // if a is 0, it's linear
+        {
+            if (fabs(b) >= eps2)
+                res[num++] = -c/b;
+        }
+        else
+        {
+            float discriminant = b*b - 4*a*c;
+            if (discriminant < 0)
+                num = 0;
+            else
+            {
+                float root = (float) sqrt(discriminant);
+                res[0] = (-b - root)/(2*a);
+                res[1] = (-b + root)/(2*a);
+                num = 2; // don't bother distinguishing 1-solution case, as code below will still work
+            }
+        }
+    }
+    else
+    {
+        float b = 3*(ax*bx + ay*by) * a_inv;
+        float c = (2*(ax*ax + ay*ay) + (mx*bx+my*by)) * a_inv;
+        float d = (mx*ax+my*ay) * a_inv;
+        num = SdfSolveCubic(b, c, d, res);
+    }
+    dist2 = (x0-sx)*(x0-sx) + (y0-sy)*(y0-sy);
+    if (dist2 < min_dist*min_dist)
+        min_dist = (float) sqrt(dist2);
+
+    for (int r = 0; r < num; ++r)
+    {
+        if (res[r] >= 0.0f && res[r] <= 1.0f)
+        {
+            t = res[r], it = 1.0f - t;
+            px = it*it*x0 + 2*t*it*x1 + t*t*x2;
+            py = it*it*y0 + 2*t*it*y1 + t*t*y2;
+            dist2 = (px-sx)*(px-sx) + (py-sy)*(py-sy);
+            if (dist2 < min_dist * min_dist)
+                min_dist = (float) sqrt(dist2);
+        }
+    }
+    return min_dist;
+}
+
+void SdfDistanceKernelScalar(const SdfShape* shape, int cell, float sx, float sy, float* min_dist)
+{
+    const SdfGrid& line_grid = shape->m_LineGrid;
+    const SdfGrid& quad_grid = shape->m_QuadGrid;
+    for (int p = 0; p < SDF_CELL_SIZE; ++p)
+    {
+        float md = min_dist[p];
+        for (uint32_t i = line_grid.m_CellStart[cell]; i < line_grid.m_CellStart[cell+1]; ++i)
+            md = LineDistance(shape->m_Lines, line_grid.m_Indices[i], sx + p, sy, md);
+        for (uint32_t i = quad_grid.m_CellStart[cell]; i < quad_grid.m_CellStart[cell+1]; ++i)
+            md = QuadDistance(shape->m_Quads, quad_grid.m_Indices[i], sx + p, sy, md);
+        min_dist[p] = md;
+    }
+}
+
+// Visits the signed distances (pixels, negative outside) of the rows [row_start, row_end), left to right.
+// The writer is inlined, so the 8 bit and float outputs share the same loop
+template <typename Writer>
+static void GenerateRows(SdfShape* shape, int row_start, int row_end, Writer& writer, void* scratch)
+{
+    float scale_x = shape->m_Scale;
+    float scale_y = -shape->m_Scale;
+    int w = shape->m_Width;
+
+    // Each line crosses a row at most once, and each quad at most twice.
+    // The rows may be generated by several threads at once, so the buffer is the caller's scratch, or on the stack
+    SdfCrossing stack_crossings[SDF_STACK_CROSSINGS];
+    int max_crossings = shape->m_NumSegments * 2 + 1;
+    SdfCrossing* crossings = stack_crossings;
+    if (max_crossings > SDF_STACK_CROSSINGS)
+        crossings = scratch ? (SdfCrossing*)scratch : (SdfCrossing*)malloc(max_crossings * sizeof(SdfCrossing));
+
+    for (int row = row_start; row < row_end; ++row)
+    {
+        int y = shape->m_Y0 + row;
+        float sy = (float) y + 0.5f;
+
+        // make sure y never passes through a vertex of the shape
+        float y_gspace = (sy / scale_y);
+        float y_frac = (float) fmod(y_gspace, 1.0f);
+        if (y_frac < 0.01f)
+            y_gspace += 0.01f;
+        else if (y_frac > 0.99f)
+            y_gspace -= 0.01f;
+
+        int num_crossings = ComputeRowCrossings(shape, y_gspace, crossings);
+        int crossing = 0;
+        int winding = 0;
+
+        for (int cx = 0; cx < shape->m_CellsX; ++cx)
+        {
+            int col_start = cx * SDF_CELL_SIZE;
+            int count = w - col_start < SDF_CELL_SIZE ? w - col_start : SDF_CELL_SIZE;
+
+            float min_dist[SDF_CELL_SIZE];
+            for (int p = 0; p < SDF_CELL_SIZE; ++p)
+                min_dist[p] = 999999.0f;
+
+            float sx = (float) (shape->m_X0 + col_start) + 0.5f;
+            shape->m_Kernel(shape, (row / SDF_CELL_SIZE) * shape->m_CellsX + cx, sx, sy, min_dist);
+
+            for (int p = 0; p < count; ++p)
+            {
+                // The pixels are visited left to right, so only the new crossings need to be added
+                float x_gspace = ((sx + p) / scale_x);
+                for (; crossing < num_crossings && crossings[crossing].m_X < x_gspace; ++crossing)
+                    winding += crossings[crossing].m_Winding;
+
+                float dist = min_dist[p];
+                if (winding == 0)
+                    dist = -dist;  // if outside the shape, value is negative
+                writer.Write(row * w + col_start + p, dist);
+            }
+        }
+    }
+
+    if (crossings != stack_crossings && crossings != scratch)
+        free(crossings);
+}
+
+uint32_t SdfGetRowScratchSize(const SdfShape* shape)
+{
+    int max_crossings = shape->m_NumSegments * 2 + 1;
+    return max_crossings <= SDF_STACK_CROSSINGS ? 0 : max_crossings * sizeof(SdfCrossing);
+}
+
+static inline uint8_t QuantizeDistance(float dist, uint8_t edge, float pixel_dist_scale)
+{
+    float val = edge + pixel_dist_scale * dist;
+    if (val < 0)
+        val = 0;
+    else if (val > 255)
+        val = 255;
+    return (uint8_t) val;
+}
+
+struct QuantizedWriter
+{
+    uint8_t*    m_Out;
+    int         m_Stride;
+    uint8_t     m_Edge;
+    float       m_PixelDistScale;
+
+    inline void Write(int index, float dist)
+    {
+        m_Out[index * m_Stride] = QuantizeDistance(dist, m_Edge, m_PixelDistScale);
+    }
+};
+
+struct DistanceWriter
+{
+    float*      m_Out;
+
+    inline void Write(int index, float dist)
+    {
+        m_Out[index] = dist;
+    }
+};
+
+void SdfGenerateRows(SdfShape* shape, int row_start, int row_end, uint8_t edge, float pixel_dist_scale, uint8_t* out, int stride, void* scratch)
+{
+    QuantizedWriter writer = { out, stride, edge, pixel_dist_scale };
+    GenerateRows(shape, row_start, row_end, writer, scratch);
+}
+
+void SdfGenerateDistanceRows(SdfShape* shape, int row_start, int row_end, float* out, void* scratch)
+{
+    DistanceWriter writer = { out };
+    GenerateRows(shape, row_start, row_end, writer, scratch);
+}
+
+void SdfQuantizeDistances(const float* distances, int pitch, int x, int y, int w, int h, uint8_t edge, float pixel_dist_scale, uint8_t* out, int stride)
+{
+    for (int row = 0; row < h; ++row)
+    {
+        const float* src = distances + (y + row) * pitch + x;
+        uint8_t* dst = out + row * w * stride;
+        for (int col = 0; col < w; ++col)
+            dst[col * stride] = QuantizeDistance(src[col], edge, pixel_dist_scale);
+    }
+}
+
+// ****************************************************************************************************
+// Gaussian blur
+
+// The kernel covers 3 standard deviations
+static int GetBlurKernel(float radius, float* weights, int max_size)
+{
+    int half = (int)ceilf(radius);
+    if (half > max_size)
+        half = max_size;
+    float sigma = radius / 3.0f;
+    float sum = 0.0f;
+    for (int i = -half; i <= half; ++i)
+    {
+        float w = expf(-(i * i) / (2.0f * sigma * sigma));
+        weights[i + half] = w;
+        sum += w;
+    }
+    for (int i = 0; i < 2 * half + 1; ++i)
+        weights[i] /= sum;
+    return half;
+}
+
+void SdfBlur(uint8_t* image, int w, int h, int stride, int src_channel, int dst_channel, float radius, Arena* arena)
+{
+    if (radius <= 0.0f)
+    {
+        for (int i = 0; i < w * h; ++i)
+            image[i * stride + dst_channel] = image[i * stride + src_channel];
+        return;
+    }
+
+    float weights[2 * SDF_MAX_BLUR_RADIUS + 1];
+    int half = GetBlurKernel(radius, weights, SDF_MAX_BLUR_RADIUS);
+
+    // The horizontal pass goes to a float image, so the rounding is only done once
+    float* tmp = (float*)ArenaAlloc(arena, w * h * sizeof(float));
+    for (int y = 0; y < h; ++y)
+    {
+        const uint8_t* src = image + y * w * stride + src_channel;
+        float* dst = tmp + y * w;
+        for (int x = 0; x < w; ++x)
+        {
+            float sum = 0.0f;
+            for (int i = -half; i <= half; ++i)
+            {
+                int sx = x + i;
+                sx = sx < 0 ? 0 : (sx >= w ? w - 1 : sx); // The border pixels are repeated
+                sum += weights[i + half] * src[sx * stride];
+            }
+            dst[x] = sum;
+        }
+    }
+
+    for (int y = 0; y < h; ++y)
+    {
+        uint8_t* dst = image + y * w * stride + dst_channel;
+        for (int x = 0; x < w; ++x)
+        {
+            float sum = 0.0f;
+            for (int i = -half; i <= half; ++i)
+            {
+                int sy = y + i;
+                sy = sy < 0 ? 0 : (sy >= h ? h - 1 : sy);
+                sum += weights[i + half] * tmp[sy * w + x];
+            }
+            int val = (int)(sum + 0.5f);
+            dst[x * stride] = (uint8_t)(val > 255 ? 255 : val);
+        }
+    }
+    ArenaFree(arena, tmp);
+}
+
+} // namespace
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include "stb_truetype.h" // stbtt_vertex
+
+namespace dmFontGen
+{
+    /*
+     * A glyph outline, scaled into pixel space (y-down), together with a spatial index
+     * that maps each cell of the output image to the outline segments that may affect it.
+     */
+    struct SdfShape;
+    struct Arena;
+
+    enum SdfKernel
+    {
+        SDF_KERNEL_AUTO,    // The fastest kernel supported by the cpu
+        SDF_KERNEL_SCALAR,
+        SDF_KERNEL_SSE2,
+        SDF_KERNEL_AVX2,
+        SDF_KERNEL_NEON,
+    };
+
+    enum SdfAlgorithm
+    {
+        SDF_ALGORITHM_ANALYTIC, // The exact distance to the outline (see sdf.cpp)
+        SDF_ALGORITHM_RASTER,   // A distance transform of a rasterized glyph (see sdf_raster.cpp)
+        SDF_ALGORITHM_MSDF,     // A multi channel (rgb) distance field, with sharp corners (see sdf_msdf.cpp)
+    };
+
+    struct SdfShapeParams
+    {
+        const stbtt_vertex* m_Vertices;     // The glyph outline (font units)
+        int                 m_NumVertices;
+        float               m_Scale;        // Font units to pixels
+        int                 m_X0;           // The pixel rect of the output image (see stbtt_GetGlyphSDF)
+        int                 m_Y0;
+        int                 m_Width;
+        int                 m_Height;
+        float               m_MaxDistance;  // Beyond this distance (in pixels), the output value is expected to saturate
+        Arena*              m_Arena;        // The memory for the shapes and scratch buffers (see arena.h). May be 0 to use malloc. Must outlive the shapes
+    };
+
+    /*
+     * Scales the outline and builds the spatial index. Returns 0 on failure
+     */
+    SdfShape* SdfCreateShape(const SdfShapeParams& params);
+
+    void SdfDeleteShape(SdfShape* shape);
+
+    /*
+     * Gets an estimate of the cost of generating the shape (pixels * segments)
+     */
+    uint64_t SdfGetCost(const SdfShape* shape);
+
+    /*
+     * Gets the max distance (in pixels) that affects the output, given the sdf encoding
+     */
+    float SdfGetMaxDistance(uint8_t edge, float pixel_dist_scale);
+
+    /*
+     * Writes the 8 bit signed distance values of the rows [row_start, row_end) into out.
+     * The output is compatible with stbtt_GetGlyphSDF(), see sdf.cpp for the tolerance.
+     * The out pointer points to the first pixel of the image, with stride bytes per pixel and a pitch of m_Width*stride.
+     * This allows writing into one channel of an interleaved image.
+     * The scratch holds SdfGetRowScratchSize() bytes, or is 0 (then it's on the stack, or malloc'ed for very complex glyphs)
+     */
+    void SdfGenerateRows(SdfShape* shape, int row_start, int row_end, uint8_t edge, float pixel_dist_scale, uint8_t* out, int stride, void* scratch);
+
+    /*
+     * Writes the signed distances (in pixels, negative outside) of the rows [row_start, row_end) into out, with a pitch of m_Width floats.
+     * Quantizing them with SdfQuantizeDistances() gives the same values as SdfGenerateRows(), for any distance within
+     * the m_MaxDistance of the shape. So one distance field can serve several sdf encodings (edge, padding and channels).
+     * The scratch is the same as for SdfGenerateRows()
+     */
+    void SdfGenerateDistanceRows(SdfShape* shape, int row_start, int row_end, float* out, void* scratch);
+
+    /*
+     * Gets the scratch memory (in bytes) needed to generate rows of the shape, or 0 if they fit on the stack.
+     * Each thread generating rows at the same time needs its own scratch
+     */
+    uint32_t SdfGetRowScratchSize(const SdfShape* shape);
+
+    /*
+     * Writes the 8 bit signed distance values of the w*h rect at (x, y) of a distance field (with a pitch of `pitch` floats) into out.
+     * The out pointer has stride bytes per pixel, and a pitch of w*stride (see SdfGenerateRows())
+     */
+    void SdfQuantizeDistances(const float* distances, int pitch, int x, int y, int w, int h, uint8_t edge, float pixel_dist_scale, uint8_t* out, int stride);
+
+    static const int SDF_MAX_BLUR_RADIUS = 64;
+
+    /*
+     * Writes a gaussian blur of one channel of a w*h image (stride bytes per pixel) into another channel of the same image.
+     * The blur is separable (a horizontal and a vertical pass), and covers radius pixels in each direction (at most SDF_MAX_BLUR_RADIUS).
+     * A radius of 0 copies the channel. The scratch memory is allocated from the arena (may be 0)
+     */
+    void SdfBlur(uint8_t* image, int w, int h, int stride, int src_channel, int dst_channel, float radius, Arena* arena);
+
+    /*
+     * Selects the distance kernel used by shapes created after this call.
+     * Returns false if the kernel isn't supported on this platform/cpu.
+     */
+    bool SdfSetKernel(SdfKernel kernel);
+
+    /*
+     * Gets the currently selected kernel (never SDF_KERNEL_AUTO)
+     */
+    SdfKernel SdfGetKernel();
+
+    /*
+     * Writes the 8 bit signed distance values of the glyph, using SDF_ALGORITHM_RASTER.
+     * The out pointer has stride bytes per pixel (see SdfGenerateRows()). The userdata is passed to the stb_truetype allocator.
+     * Returns false if the glyph has no outline
+     */
+    bool SdfGenerateRaster(const SdfShapeParams& params, uint8_t edge, float pixel_dist_scale, void* userdata, uint8_t* out, int stride);
+
+    /*
+     * The outline of a glyph, with the edges colored for the multi channel sdf (see sdf_msdf.cpp)
+     */
+    struct MsdfShape;
+
+    /*
+     * Scales the outline and colors the edges. Returns 0 on failure
+     */
+    MsdfShape* SdfCreateMsdfShape(const SdfShapeParams& params);
+
+    void SdfDeleteMsdfShape(MsdfShape* shape);
+
+    /*
+     * Writes the 3 channel (rgb) signed distance values of the rows [row_start, row_end), using SDF_ALGORITHM_MSDF.
+     * The out pointer points to the first pixel of the image, with a pitch of m_Width*3.
+     * The first channel of out must hold the output of SdfGenerateRows() (with a stride of 3) for the same rows,
+     * which is used for error correction and then overwritten.
+     * The scratch holds SdfGetMsdfRowScratchSize() bytes, or is 0 (then it's on the stack, or malloc'ed for very complex glyphs)
+     */
+    void SdfGenerateMsdfRows(MsdfShape* shape, int row_start, int row_end, uint8_t edge, float pixel_dist_scale, uint8_t* out, void* scratch);
+
+    /*
+     * Gets the scratch memory (in bytes) needed by SdfGenerateMsdfRows(), or 0 if it fits on the stack
+     */
+    uint32_t SdfGetMsdfRowScratchSize(const MsdfShape* shape);
+}
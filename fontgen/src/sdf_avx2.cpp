@@ -0,0 +1,73 @@
+// The AVX2 distance kernel (x86-64), see sdf_kernel.h
+// The file is compiled for AVX2 (regardless of the compiler flags), and the kernel is only selected if the cpu supports it
+
+#include "sdf_private.h"
+
+#if defined(FONTGEN_SDF_AVX2)
+
+#include <math.h>
+
+#if defined(__clang__)
+    #pragma clang attribute push (__attribute__((target("avx2"))), apply_to=function)
+#else
+    #pragma GCC push_options
+    #pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+#include "sdf_kernel.h"
+
+namespace dmFontGen
+{
+
+struct VecAVX2
+{
+    typedef __m256 F;
+    typedef __m256 M;
+    enum { WIDTH = 8 };
+
+    static inline F Set1(float v)               { return _mm256_set1_ps(v); }
+    static inline F Zero()                      { return _mm256_setzero_ps(); }
+    static inline F Lanes()                     { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+    static inline F Load(const float* p)        { return _mm256_loadu_ps(p); }
+    static inline void Store(float* p, F v)     { _mm256_storeu_ps(p, v); }
+
+    static inline F Add(F a, F b)               { return _mm256_add_ps(a, b); }
+    static inline F Sub(F a, F b)               { return _mm256_sub_ps(a, b); }
+    static inline F Mul(F a, F b)               { return _mm256_mul_ps(a, b); }
+    static inline F Div(F a, F b)               { return _mm256_div_ps(a, b); }
+    static inline F Sqrt(F a)                   { return _mm256_sqrt_ps(a); }
+    static inline F Abs(F a)                    { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static inline F Neg(F a)                    { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+
+    static inline M Lt(F a, F b)                { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline M Le(F a, F b)                { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static inline M Gt(F a, F b)                { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static inline M Ge(F a, F b)                { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static inline M Eq(F a, F b)                { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static inline M True()                      { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+    static inline M False()                     { return _mm256_setzero_ps(); }
+    static inline M And(M a, M b)               { return _mm256_and_ps(a, b); }
+    static inline M Not(M a)                    { return _mm256_xor_ps(a, True()); }
+    static inline bool Any(M a)                 { return _mm256_movemask_ps(a) != 0; }
+    static inline F Select(M m, F a, F b)       { return _mm256_blendv_ps(b, a, m); }
+
+    // The integer value of the bits of a float, and vice versa
+    static inline F BitsToValue(F a)            { return _mm256_cvtepi32_ps(_mm256_castps_si256(a)); }
+    static inline F ValueToBits(F a)            { return _mm256_castsi256_ps(_mm256_cvtps_epi32(a)); }
+};
+
+void SdfDistanceKernelAVX2(const SdfShape* shape, int cell, float sx, float sy, float* min_dist)
+{
+    SdfDistanceKernel<VecAVX2>(shape, cell, sx, sy, min_dist);
+}
+
+} // namespace
+
+#if defined(__clang__)
+    #pragma clang attribute pop
+#else
+    #pragma GCC pop_options
+#endif
+
+#endif // FONTGEN_SDF_AVX2
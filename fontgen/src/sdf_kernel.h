@@ -0,0 +1,275 @@
+#pragma once
+
+// The vectorized distance kernel, shared by the instruction set specific implementations.
+// V is a struct providing the vector type (F), the mask type (M), the lane count (WIDTH) and the operations.
+//
+// Each call evaluates WIDTH pixels of a row against one segment at a time.
+// The math and the operation order is the same as in the scalar kernel (sdf.cpp), except for the cubic solver,
+// where cbrt(), acos() and cos() are replaced with polynomial/newton approximations.
+// The approximations are accurate to a few ulps, which in rare cases changes a pixel value by one step.
+
+#include "sdf_private.h"
+
+namespace dmFontGen
+{
+
+// Only valid for x >= 0
+template<typename V>
+static inline typename V::F SdfCbrtPositive(typename V::F x)
+{
+    typedef typename V::F F;
+    // Initial guess: divide the exponent by 3
+    F y = V::ValueToBits(V::Add(V::Mul(V::BitsToValue(x), V::Set1(1.0f/3.0f)), V::Set1(709921077.0f)));
+    F three = V::Set1(3.0f);
+    for (int i = 0; i < 3; ++i)
+    {
+        F y2 = V::Mul(y, y);
+        y = V::Sub(y, V::Div(V::Sub(V::Mul(y2, y), x), V::Mul(three, y2)));
+    }
+    return V::Select(V::Eq(x, V::Zero()), V::Zero(), y);
+}
+
+template<typename V>
+static inline typename V::F SdfCbrt(typename V::F x)
+{
+    typedef typename V::F F;
+    F y = SdfCbrtPositive<V>(V::Abs(x));
+    return V::Select(V::Lt(x, V::Zero()), V::Neg(y), y);
+}
+
+// Abramowitz and Stegun 4.4.46, |error| <= 2e-8
+template<typename V>
+static inline typename V::F SdfAcos(typename V::F x)
+{
+    typedef typename V::F F;
+    F ax = V::Abs(x);
+    F p = V::Set1(-0.0012624911f);
+    p = V::Add(V::Mul(p, ax), V::Set1(0.0066700901f));
+    p = V::Add(V::Mul(p, ax), V::Set1(-0.0170881256f));
+    p = V::Add(V::Mul(p, ax), V::Set1(0.0308918810f));
+    p = V::Add(V::Mul(p, ax), V::Set1(-0.0501743046f));
+    p = V::Add(V::Mul(p, ax), V::Set1(0.0889789874f));
+    p = V::Add(V::Mul(p, ax), V::Set1(-0.2145988016f));
+    p = V::Add(V::Mul(p, ax), V::Set1(1.5707963050f));
+    F r = V::Mul(V::Sqrt(V::Sub(V::Set1(1.0f), ax)), p); // NaN if |x| > 1, same as acos()
+    return V::Select(V::Lt(x, V::Zero()), V::Sub(V::Set1(3.14159265f), r), r);
+}
+
+// Taylor series, valid for [0, pi/3]
+template<typename V>
+static inline typename V::F SdfCos(typename V::F x)
+{
+    typedef typename V::F F;
+    F x2 = V::Mul(x, x);
+    F p = V::Set1(-1.0f/3628800.0f);
+    p = V::Add(V::Mul(p, x2), V::Set1(1.0f/40320.0f));
+    p = V::Add(V::Mul(p, x2), V::Set1(-1.0f/720.0f));
+    p = V::Add(V::Mul(p, x2), V::Set1(1.0f/24.0f));
+    p = V::Add(V::Mul(p, x2), V::Set1(-1.0f/2.0f));
+    p = V::Add(V::Mul(p, x2), V::Set1(1.0f));
+    return p;
+}
+
+// Taylor series, valid for [0, pi/3]
+template<typename V>
+static inline typename V::F SdfSin(typename V::F x)
+{
+    typedef typename V::F F;
+    F x2 = V::Mul(x, x);
+    F p = V::Set1(-1.0f/39916800.0f);
+    p = V::Add(V::Mul(p, x2), V::Set1(1.0f/362880.0f));
+    p = V::Add(V::Mul(p, x2), V::Set1(-1.0f/5040.0f));
+    p = V::Add(V::Mul(p, x2), V::Set1(1.0f/120.0f));
+    p = V::Add(V::Mul(p, x2), V::Set1(-1.0f/6.0f));
+    p = V::Add(V::Mul(p, x2), V::Set1(1.0f));
+    return V::Mul(p, x);
+}
+
+template<typename V>
+static inline void SdfUpdateMinDist(typename V::M mask, typename V::F dist2, typename V::F& min_dist)
+{
+    typename V::M closer = V::And(mask, V::Lt(dist2, V::Mul(min_dist, min_dist)));
+    if (V::Any(closer))
+        min_dist = V::Select(closer, V::Sqrt(dist2), min_dist);
+}
+
+template<typename V>
+static inline void SdfLineDistance(const SdfLines& lines, uint32_t i, typename V::F sx, float sy, typename V::F& min_dist)
+{
+    typedef typename V::F F;
+    typedef typename V::M M;
+
+    float x0 = lines.m_X0[i], y0 = lines.m_Y0[i];
+    float x1 = lines.m_X1[i], y1 = lines.m_Y1[i];
+    float dx = x1-x0, dy = y1-y0;
+
+    F px = V::Sub(V::Set1(x0), sx); // x0-sx
+    float py = y0-sy;
+
+    F dist2 = V::Add(V::Mul(px, px), V::Set1(py*py));
+    SdfUpdateMinDist<V>(V::True(), dist2, min_dist);
+
+    F dist = V::Mul(V::Abs(V::Sub(V::Set1(dx*py), V::Mul(V::Set1(dy), px))), V::Set1(lines.m_InvLength[i]));
+    M closer = V::Lt(dist, min_dist);
+    if (!V::Any(closer))
+        return;
+
+    // check position along line
+    F t = V::Div(V::Neg(V::Add(V::Mul(px, V::Set1(dx)), V::Set1(py*dy))), V::Set1(dx*dx + dy*dy));
+    M on_line = V::And(closer, V::And(V::Ge(t, V::Zero()), V::Le(t, V::Set1(1.0f))));
+    min_dist = V::Select(on_line, dist, min_dist);
+}
+
+template<typename V>
+static inline void SdfQuadRootDistance(typename V::M valid, typename V::F t, typename V::F sx, float sy,
+                                        float x0, float y0, float x1, float y1, float x2, float y2, typename V::F& min_dist)
+{
+    typedef typename V::F F;
+    typedef typename V::M M;
+
+    M mask = V::And(valid, V::And(V::Ge(t, V::Zero()), V::Le(t, V::Set1(1.0f))));
+    if (!V::Any(mask))
+        return;
+
+    F it = V::Sub(V::Set1(1.0f), t);
+    F a = V::Mul(it, it);
+    F b = V::Mul(V::Mul(V::Set1(2.0f), t), it);
+    F c = V::Mul(t, t);
+    F px = V::Add(V::Add(V::Mul(a, V::Set1(x0)), V::Mul(b, V::Set1(x1))), V::Mul(c, V::Set1(x2)));
+    F py = V::Add(V::Add(V::Mul(a, V::Set1(y0)), V::Mul(b, V::Set1(y1))), V::Mul(c, V::Set1(y2)));
+    F dx = V::Sub(px, sx);
+    F dy = V::Sub(py, V::Set1(sy));
+    SdfUpdateMinDist<V>(mask, V::Add(V::Mul(dx, dx), V::Mul(dy, dy)), min_dist);
+}
+
+template<typename V>
+static inline void SdfQuadDistance(const SdfQuads& quads, uint32_t i, typename V::F sx, float sy, typename V::F& min_dist)
+{
+    typedef typename V::F F;
+    typedef typename V::M M;
+    const float eps = 1./1024, eps2 = eps*eps;
+
+    // coarse culling against bbox to avoid computing cubic unnecessarily
+    F vsy = V::Set1(sy);
+    M inside = V::And(V::And(V::Gt(sx, V::Sub(V::Set1(quads.m_MinX[i]), min_dist)), V::Lt(sx, V::Add(V::Set1(quads.m_MaxX[i]), min_dist))),
+                      V::And(V::Gt(vsy, V::Sub(V::Set1(quads.m_MinY[i]), min_dist)), V::Lt(vsy, V::Add(V::Set1(quads.m_MaxY[i]), min_dist))));
+    if (!V::Any(inside))
+        return;
+
+    float x0 = quads.m_X0[i], y0 = quads.m_Y0[i];
+    float x1 = quads.m_X1[i], y1 = quads.m_Y1[i];
+    float x2 = quads.m_X2[i], y2 = quads.m_Y2[i];
+
+    float ax = x1-x0, ay = y1-y0;
+    float bx = x0 - 2*x1 + x2, by = y0 - 2*y1 + y2;
+    F mx = V::Sub(V::Set1(x0), sx);
+    float my = y0 - sy;
+
+    F res[3];
+    M valid[3];
+    valid[0] = valid[1] = valid[2] = V::False();
+    res[0] = res[1] = res[2] = V::Zero();
+
+    // mx*bx+my*by, mx*ax+my*ay
+    F mb = V::Add(V::Mul(mx, V::Set1(bx)), V::Set1(my*by));
+    F ma = V::Add(V::Mul(mx, V::Set1(ax)), V::Set1(my*ay));
+
+    float a_inv = quads.m_InvA[i];
+    if (a_inv == 0.0) // if a_inv is 0, it's 2nd degree so use quadratic formula
+    {
+        float a = 3*(ax*bx + ay*by);
+        F b = V::Add(V::Set1(2*(ax*ax + ay*ay)), mb);
+        F c = ma;
+        if (fabsf(a) < eps2) // if a is 0, it's linear
+        {
+            valid[0] = V::Ge(V::Abs(b), V::Set1(eps2));
+            res[0] = V::Div(V::Neg(c), b);
+        }
+        else
+        {
+            F discriminant = V::Sub(V::Mul(b, b), V::Mul(V::Set1(4*a), c));
+            F root = V::Sqrt(discriminant);
+            F nb = V::Neg(b);
+            valid[0] = valid[1] = V::Ge(discriminant, V::Zero());
+            res[0] = V::Div(V::Sub(nb, root), V::Set1(2*a));
+            res[1] = V::Div(V::Add(nb, root), V::Set1(2*a));
+        }
+    }
+    else
+    {
+        // x^3 + a*x^2 + b*x + c = 0
+        float a = 3*(ax*bx + ay*by) * a_inv;
+        F b = V::Mul(V::Add(V::Set1(2*(ax*ax + ay*ay)), mb), V::Set1(a_inv));
+        F c = V::Mul(ma, V::Set1(a_inv));
+
+        float s = -a / 3;
+        F p = V::Sub(b, V::Set1(a*a / 3));
+        F q = V::Add(V::Div(V::Mul(V::Set1(a), V::Sub(V::Set1(2*a*a), V::Mul(V::Set1(9.0f), b))), V::Set1(27.0f)), c);
+        F p3 = V::Mul(V::Mul(p, p), p);
+        F d = V::Add(V::Mul(q, q), V::Div(V::Mul(V::Set1(4.0f), p3), V::Set1(27.0f)));
+        M one_root = V::Ge(d, V::Zero());
+        F nq = V::Neg(q);
+
+        F r_one = V::Zero();
+        if (V::Any(one_root))
+        {
+            F z = V::Sqrt(d);
+            F u = SdfCbrt<V>(V::Mul(V::Add(nq, z), V::Set1(0.5f)));
+            F v = SdfCbrt<V>(V::Mul(V::Sub(nq, z), V::Set1(0.5f)));
+            r_one = V::Add(V::Add(V::Set1(s), u), v);
+        }
+
+        M three_roots = V::Not(one_root);
+        F r_three0 = V::Zero();
+        if (V::Any(three_roots))
+        {
+            F u = V::Sqrt(V::Div(V::Neg(p), V::Set1(3.0f)));
+            F acos_arg = V::Mul(V::Mul(V::Neg(V::Sqrt(V::Div(V::Set1(-27.0f), p3))), q), V::Set1(0.5f));
+            F v = V::Div(SdfAcos<V>(acos_arg), V::Set1(3.0f));
+            F m = SdfCos<V>(v);
+            F n = V::Mul(SdfSin<V>(v), V::Set1(1.732050808f));
+            r_three0 = V::Add(V::Set1(s), V::Mul(V::Mul(u, V::Set1(2.0f)), m));
+            res[1] = V::Sub(V::Set1(s), V::Mul(u, V::Add(m, n)));
+            res[2] = V::Sub(V::Set1(s), V::Mul(u, V::Sub(m, n)));
+            valid[1] = valid[2] = three_roots;
+        }
+        res[0] = V::Select(one_root, r_one, r_three0);
+        valid[0] = V::True();
+    }
+
+    F dist2 = V::Add(V::Mul(mx, mx), V::Set1(my*my));
+    SdfUpdateMinDist<V>(inside, dist2, min_dist);
+
+    for (int r = 0; r < 3; ++r)
+    {
+        SdfQuadRootDistance<V>(V::And(inside, valid[r]), res[r], sx, sy, x0, y0, x1, y1, x2, y2, min_dist);
+    }
+}
+
+template<typename V>
+static inline void SdfDistanceKernel(const SdfShape* shape, int cell, float sx, float sy, float* min_dist)
+{
+    typedef typename V::F F;
+
+    const SdfGrid& line_grid = shape->m_LineGrid;
+    const SdfGrid& quad_grid = shape->m_QuadGrid;
+    uint32_t line_start = line_grid.m_CellStart[cell];
+    uint32_t line_end   = line_grid.m_CellStart[cell+1];
+    uint32_t quad_start = quad_grid.m_CellStart[cell];
+    uint32_t quad_end   = quad_grid.m_CellStart[cell+1];
+
+    for (int base = 0; base < SDF_CELL_SIZE; base += V::WIDTH)
+    {
+        F vsx = V::Add(V::Set1(sx + base), V::Lanes());
+        F md = V::Load(min_dist + base);
+
+        for (uint32_t i = line_start; i < line_end; ++i)
+            SdfLineDistance<V>(shape->m_Lines, line_grid.m_Indices[i], vsx, sy, md);
+        for (uint32_t i = quad_start; i < quad_end; ++i)
+            SdfQuadDistance<V>(shape->m_Quads, quad_grid.m_Indices[i], vsx, sy, md);
+
+        V::Store(min_dist + base, md);
+    }
+}
+
+} // namespace
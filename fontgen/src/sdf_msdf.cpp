@@ -0,0 +1,653 @@
+// The multi channel signed distance field generator
+//
+// Based on "Shape Decomposition for Multi-channel Distance Fields" (V. Chlumsky), and msdfgen:
+//   * The edges of each contour are colored, so that the two edges meeting at a corner never share more than one channel
+//   * Each channel stores the signed pseudo distance to the nearest edge of that color
+//   * The shader reconstructs the distance as the median of the three channels, which keeps the corners sharp
+//
+// Each pixel is checked against the (single channel) signed distance field of the glyph, and if
+// the median has the wrong sign, all channels are set to the single channel value (simple error correction).
+// Channels without an edge within the max distance saturate, with the sign of the single channel value.
+
+#include "sdf.h"
+#include "sdf_private.h"
+#include "arena.h"
+
+#include <stdlib.h> // malloc
+#include <string.h> // memset
+#include <math.h>
+
+namespace dmFontGen
+{
+
+enum MsdfColor
+{
+    MSDF_COLOR_BLACK    = 0,
+    MSDF_COLOR_RED      = 1,
+    MSDF_COLOR_GREEN    = 2,
+    MSDF_COLOR_YELLOW   = 3,
+    MSDF_COLOR_BLUE     = 4,
+    MSDF_COLOR_MAGENTA  = 5,
+    MSDF_COLOR_CYAN     = 6,
+    MSDF_COLOR_WHITE    = 7,
+};
+
+// An edge in pixel space (y-down). Lines use the first two points
+struct MsdfEdge
+{
+    float   m_X[3];
+    float   m_Y[3];
+    float   m_MinX, m_MinY, m_MaxX, m_MaxY;
+    uint8_t m_Type;     // SdfSegmentType
+    uint8_t m_Color;    // MsdfColor
+};
+
+struct MsdfShape
+{
+    MsdfEdge*   m_Edges;
+    int         m_NumEdges;
+    int*        m_Contours;     // The first edge of each contour, with an extra item at the end
+    int         m_NumContours;
+    float       m_Orientation;  // 1 if the inside is to the left of the edges, -1 otherwise
+
+    int         m_X0;
+    int         m_Y0;
+    int         m_Width;
+    int         m_Height;
+    float       m_MaxDistance;
+    Arena*      m_Arena;        // Where the memory was allocated
+};
+
+static const int MSDF_STACK_ACTIVE_EDGES = 1024;
+
+static const float MSDF_CORNER_THRESHOLD = 0.1411f; // sin(3.0), see msdfgen edgeColoringSimple()
+static const float MSDF_EPSILON = 1.0f / 1024.0f;
+
+// ****************************************************************************************************
+// Edges
+
+static inline float Cross(float ax, float ay, float bx, float by)
+{
+    return ax*by - ay*bx;
+}
+
+static inline void Normalize(float* x, float* y)
+{
+    float len = sqrtf(*x * *x + *y * *y);
+    if (len > 0)
+    {
+        *x /= len;
+        *y /= len;
+    }
+}
+
+static void EdgePoint(const MsdfEdge& e, float t, float* x, float* y)
+{
+    if (e.m_Type == SDF_SEGMENT_LINE)
+    {
+        *x = e.m_X[0] + t * (e.m_X[1] - e.m_X[0]);
+        *y = e.m_Y[0] + t * (e.m_Y[1] - e.m_Y[0]);
+    }
+    else
+    {
+        float it = 1.0f - t;
+        *x = it*it*e.m_X[0] + 2*t*it*e.m_X[1] + t*t*e.m_X[2];
+        *y = it*it*e.m_Y[0] + 2*t*it*e.m_Y[1] + t*t*e.m_Y[2];
+    }
+}
+
+// The (normalized) direction of the edge at t
+static void EdgeDirection(const MsdfEdge& e, float t, float* dx, float* dy)
+{
+    if (e.m_Type == SDF_SEGMENT_LINE)
+    {
+        *dx = e.m_X[1] - e.m_X[0];
+        *dy = e.m_Y[1] - e.m_Y[0];
+    }
+    else
+    {
+        *dx = (e.m_X[1] - e.m_X[0]) * (1.0f - t) + (e.m_X[2] - e.m_X[1]) * t;
+        *dy = (e.m_Y[1] - e.m_Y[0]) * (1.0f - t) + (e.m_Y[2] - e.m_Y[1]) * t;
+        if (fabsf(*dx) < MSDF_EPSILON && fabsf(*dy) < MSDF_EPSILON) // the control point is on an end point
+        {
+            *dx = e.m_X[2] - e.m_X[0];
+            *dy = e.m_Y[2] - e.m_Y[0];
+        }
+    }
+    Normalize(dx, dy);
+}
+
+static void UpdateBounds(MsdfEdge* e)
+{
+    int n = e->m_Type == SDF_SEGMENT_LINE ? 2 : 3;
+    e->m_MinX = e->m_MaxX = e->m_X[0];
+    e->m_MinY = e->m_MaxY = e->m_Y[0];
+    for (int i = 1; i < n; ++i)
+    {
+        e->m_MinX = e->m_X[i] < e->m_MinX ? e->m_X[i] : e->m_MinX;
+        e->m_MinY = e->m_Y[i] < e->m_MinY ? e->m_Y[i] : e->m_MinY;
+        e->m_MaxX = e->m_X[i] > e->m_MaxX ? e->m_X[i] : e->m_MaxX;
+        e->m_MaxY = e->m_Y[i] > e->m_MaxY ? e->m_Y[i] : e->m_MaxY;
+    }
+}
+
+// Gets the part [t0, t1] of the edge
+static MsdfEdge SubEdge(const MsdfEdge& e, float t0, float t1)
+{
+    MsdfEdge sub = e;
+    EdgePoint(e, t0, &sub.m_X[0], &sub.m_Y[0]);
+    if (e.m_Type == SDF_SEGMENT_LINE)
+    {
+        EdgePoint(e, t1, &sub.m_X[1], &sub.m_Y[1]);
+    }
+    else
+    {
+        // The control point is on the tangent of the start point
+        float ax = e.m_X[1] - e.m_X[0], ay = e.m_Y[1] - e.m_Y[0];
+        float bx = e.m_X[0] - 2*e.m_X[1] + e.m_X[2], by = e.m_Y[0] - 2*e.m_Y[1] + e.m_Y[2];
+        sub.m_X[1] = sub.m_X[0] + (t1 - t0) * (ax + t0 * bx);
+        sub.m_Y[1] = sub.m_Y[0] + (t1 - t0) * (ay + t0 * by);
+        EdgePoint(e, t1, &sub.m_X[2], &sub.m_Y[2]);
+    }
+    UpdateBounds(&sub);
+    return sub;
+}
+
+// Gets the distance to the edge, and the parameter t of the closest point
+static float EdgeDistance(const MsdfEdge& e, float px, float py, float* t_out)
+{
+    if (e.m_Type == SDF_SEGMENT_LINE)
+    {
+        float dx = e.m_X[1] - e.m_X[0], dy = e.m_Y[1] - e.m_Y[0];
+        float t = ((px - e.m_X[0]) * dx + (py - e.m_Y[0]) * dy) / (dx*dx + dy*dy);
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+        float x, y;
+        EdgePoint(e, t, &x, &y);
+        *t_out = t;
+        return sqrtf((x-px)*(x-px) + (y-py)*(y-py));
+    }
+
+    // Solve d/dt |B(t) - p|^2 = 0 (see QuadDistance() in sdf.cpp)
+    float ax = e.m_X[1] - e.m_X[0], ay = e.m_Y[1] - e.m_Y[0];
+    float bx = e.m_X[0] - 2*e.m_X[1] + e.m_X[2], by = e.m_Y[0] - 2*e.m_Y[1] + e.m_Y[2];
+    float mx = e.m_X[0] - px, my = e.m_Y[0] - py;
+
+    float res[5] = { 0.0f, 1.0f };
+    int num = 2; // The end points are always candidates
+    float a2 = bx*bx + by*by;
+    if (a2 >= MSDF_EPSILON * MSDF_EPSILON)
+    {
+        float a_inv = 1.0f / a2;
+        num += SdfSolveCubic(3*(ax*bx + ay*by) * a_inv, (2*(ax*ax + ay*ay) + (mx*bx + my*by)) * a_inv, (mx*ax + my*ay) * a_inv, res + 2);
+    }
+    else
+    {
+        float b = 2*(ax*ax + ay*ay) + (mx*bx + my*by);
+        if (fabsf(b) >= MSDF_EPSILON * MSDF_EPSILON)
+            res[num++] = -(mx*ax + my*ay) / b;
+    }
+
+    float best_dist2 = 3.4e38f;
+    float best_t = 0.0f;
+    for (int i = 0; i < num; ++i)
+    {
+        float t = res[i];
+        if (!(t >= 0.0f && t <= 1.0f))
+            continue;
+        float x, y;
+        EdgePoint(e, t, &x, &y);
+        float dist2 = (x-px)*(x-px) + (y-py)*(y-py);
+        if (dist2 < best_dist2)
+        {
+            best_dist2 = dist2;
+            best_t = t;
+        }
+    }
+    *t_out = best_t;
+    return sqrtf(best_dist2);
+}
+
+// How parallel the direction to the point is with the edge (0 = orthogonal). Used to select between edges at the same distance
+static float EdgeOrthogonality(const MsdfEdge& e, float px, float py, float t)
+{
+    float x, y, dx, dy;
+    EdgePoint(e, t, &x, &y);
+    EdgeDirection(e, t, &dx, &dy);
+    float vx = px - x, vy = py - y;
+    Normalize(&vx, &vy);
+    return fabsf(dx*vx + dy*vy);
+}
+
+// Gets the signed distance (positive to the left of the edge) to the edge, extended along its tangents beyond the end points
+static float EdgePseudoDistance(const MsdfEdge& e, float px, float py, float t, float dist)
+{
+    float x, y, dx, dy;
+    EdgePoint(e, t, &x, &y);
+    EdgeDirection(e, t, &dx, &dy);
+    float cross = Cross(dx, dy, px - x, py - y);
+    float sd = cross >= 0.0f ? dist : -dist;
+
+    if (t <= 0.0f || t >= 1.0f)
+    {
+        float vx = px - x, vy = py - y;
+        float along = dx*vx + dy*vy;
+        if ((t <= 0.0f && along < 0.0f) || (t >= 1.0f && along > 0.0f))
+        {
+            float pd = Cross(dx, dy, vx, vy);
+            if (fabsf(pd) <= fabsf(sd))
+                sd = pd;
+        }
+    }
+    return sd;
+}
+
+// ****************************************************************************************************
+// Shape
+
+static void AddEdge(MsdfShape* shape, int type, float scale, const float* gx, const float* gy)
+{
+    MsdfEdge* e = &shape->m_Edges[shape->m_NumEdges];
+    memset(e, 0, sizeof(*e));
+    e->m_Type = (uint8_t)type;
+    int n = type == SDF_SEGMENT_LINE ? 2 : 3;
+    for (int i = 0; i < n; ++i)
+    {
+        e->m_X[i] = gx[i] * scale;
+        e->m_Y[i] = gy[i] * -scale; // invert for y-downwards bitmaps
+    }
+
+    float dx = e->m_X[n-1] - e->m_X[0];
+    float dy = e->m_Y[n-1] - e->m_Y[0];
+    if (type == SDF_SEGMENT_LINE && fabsf(dx) < MSDF_EPSILON && fabsf(dy) < MSDF_EPSILON)
+        return; // degenerate
+
+    UpdateBounds(e);
+    shape->m_NumEdges++;
+}
+
+static void EndContour(MsdfShape* shape)
+{
+    if (shape->m_NumEdges > shape->m_Contours[shape->m_NumContours])
+        shape->m_NumContours++;
+    shape->m_Contours[shape->m_NumContours] = shape->m_NumEdges;
+}
+
+static void AddEdges(MsdfShape* shape, const stbtt_vertex* verts, int num_verts, float scale)
+{
+    shape->m_Contours[0] = 0;
+    for (int i = 0; i < num_verts; ++i)
+    {
+        const stbtt_vertex& v = verts[i];
+        if (v.type == STBTT_vmove || i == 0)
+        {
+            EndContour(shape);
+            continue;
+        }
+
+        const stbtt_vertex& prev = verts[i-1];
+        if (v.type == STBTT_vline)
+        {
+            float gx[2] = { (float)prev.x, (float)v.x };
+            float gy[2] = { (float)prev.y, (float)v.y };
+            AddEdge(shape, SDF_SEGMENT_LINE, scale, gx, gy);
+        }
+        else if (v.type == STBTT_vcurve)
+        {
+            float gx[3] = { (float)prev.x, (float)v.cx, (float)v.x };
+            float gy[3] = { (float)prev.y, (float)v.cy, (float)v.y };
+            AddEdge(shape, SDF_SEGMENT_QUAD, scale, gx, gy);
+        }
+        else if (v.type == STBTT_vcubic)
+        {
+            float px = prev.x, py = prev.y;
+            for (int s = 1; s <= SDF_CUBIC_SUBDIVISIONS; ++s)
+            {
+                float t = s / (float)SDF_CUBIC_SUBDIVISIONS;
+                float it = 1.0f - t;
+                float x = it*it*it*prev.x + 3*it*it*t*v.cx + 3*it*t*t*v.cx1 + t*t*t*v.x;
+                float y = it*it*it*prev.y + 3*it*it*t*v.cy + 3*it*t*t*v.cy1 + t*t*t*v.y;
+                float gx[2] = { px, x };
+                float gy[2] = { py, y };
+                AddEdge(shape, SDF_SEGMENT_LINE, scale, gx, gy);
+                px = x;
+                py = y;
+            }
+        }
+    }
+    EndContour(shape);
+}
+
+// Gets the max number of edges of the shape: the edges of AddEdges(), and the ones added by SplitContour().
+// The splitting triples contours of 1 or 2 edges, i.e. adds at most 4 edges to each contour
+static int CountEdges(const stbtt_vertex* verts, int num_verts, int* num_contours)
+{
+    int num_edges = 0;
+    int contour_edges = 0;
+    *num_contours = 0;
+    for (int i = 0; i <= num_verts; ++i)
+    {
+        if (i == 0 || i == num_verts || verts[i].type == STBTT_vmove)
+        {
+            if (contour_edges > 0)
+            {
+                num_edges += contour_edges + (contour_edges < 2 ? contour_edges * 2 : 4);
+                (*num_contours)++;
+            }
+            contour_edges = 0;
+            continue;
+        }
+        contour_edges += verts[i].type == STBTT_vcubic ? SDF_CUBIC_SUBDIVISIONS : 1;
+    }
+    return num_edges;
+}
+
+// The sign of the total area decides on which side of the edges the inside is
+static float GetOrientation(const MsdfShape* shape)
+{
+    float area = 0.0f;
+    for (int i = 0; i < shape->m_NumEdges; ++i)
+    {
+        const MsdfEdge& e = shape->m_Edges[i];
+        int n = e.m_Type == SDF_SEGMENT_LINE ? 2 : 3;
+        for (int p = 1; p < n; ++p)
+            area += Cross(e.m_X[p-1], e.m_Y[p-1], e.m_X[p], e.m_Y[p]);
+    }
+    return area >= 0.0f ? 1.0f : -1.0f;
+}
+
+// ****************************************************************************************************
+// Edge coloring (see msdfgen edgeColoringSimple())
+
+static uint8_t SwitchColor(uint8_t color, uint32_t* seed, uint8_t banned)
+{
+    uint8_t combined = color & banned;
+    if (combined == MSDF_COLOR_RED || combined == MSDF_COLOR_GREEN || combined == MSDF_COLOR_BLUE)
+        return combined ^ MSDF_COLOR_WHITE;
+
+    if (color == MSDF_COLOR_BLACK || color == MSDF_COLOR_WHITE)
+    {
+        static const uint8_t start[3] = { MSDF_COLOR_CYAN, MSDF_COLOR_MAGENTA, MSDF_COLOR_YELLOW };
+        color = start[*seed % 3];
+        *seed /= 3;
+        return color;
+    }
+
+    int shifted = color << (1 + (*seed & 1));
+    *seed >>= 1;
+    return (uint8_t)((shifted | shifted >> 3) & MSDF_COLOR_WHITE);
+}
+
+static bool IsCorner(const MsdfEdge& prev, const MsdfEdge& next)
+{
+    float ax, ay, bx, by;
+    EdgeDirection(prev, 1.0f, &ax, &ay);
+    EdgeDirection(next, 0.0f, &bx, &by);
+    return ax*bx + ay*by <= 0.0f || fabsf(Cross(ax, ay, bx, by)) > MSDF_CORNER_THRESHOLD;
+}
+
+// A contour with a single corner needs at least 3 edges, so the edges are split into thirds
+static void SplitContour(MsdfShape* shape, int contour)
+{
+    int start = shape->m_Contours[contour];
+    int end = shape->m_Contours[contour+1];
+    int count = end - start;
+    int extra = count * 2;
+
+    // Make room for the new edges
+    memmove(&shape->m_Edges[end + extra], &shape->m_Edges[end], (shape->m_NumEdges - end) * sizeof(MsdfEdge));
+    for (int i = contour + 1; i <= shape->m_NumContours; ++i)
+        shape->m_Contours[i] += extra;
+    shape->m_NumEdges += extra;
+
+    for (int i = count - 1; i >= 0; --i)
+    {
+        MsdfEdge e = shape->m_Edges[start + i];
+        shape->m_Edges[start + i*3 + 0] = SubEdge(e, 0.0f, 1.0f/3.0f);
+        shape->m_Edges[start + i*3 + 1] = SubEdge(e, 1.0f/3.0f, 2.0f/3.0f);
+        shape->m_Edges[start + i*3 + 2] = SubEdge(e, 2.0f/3.0f, 1.0f);
+    }
+}
+
+static void ColorEdges(MsdfShape* shape)
+{
+    uint32_t seed = 0;
+    uint8_t color = MSDF_COLOR_WHITE;
+
+    for (int c = 0; c < shape->m_NumContours; ++c)
+    {
+        int start = shape->m_Contours[c];
+        int m = shape->m_Contours[c+1] - start;
+        MsdfEdge* edges = &shape->m_Edges[start];
+
+        int num_corners = 0;
+        int first_corner = 0;
+        for (int i = 0; i < m; ++i)
+        {
+            if (IsCorner(edges[(i + m - 1) % m], edges[i]))
+            {
+                if (num_corners++ == 0)
+                    first_corner = i;
+            }
+        }
+
+        if (num_corners == 0)
+        {
+            // Smooth contour
+            color = SwitchColor(color, &seed, MSDF_COLOR_BLACK);
+            for (int i = 0; i < m; ++i)
+                edges[i].m_Color = color;
+        }
+        else if (num_corners == 1)
+        {
+            // Teardrop
+            if (m < 3)
+            {
+                SplitContour(shape, c);
+                edges = &shape->m_Edges[start];
+                first_corner *= 3;
+                m *= 3;
+            }
+
+            uint8_t colors[3];
+            colors[0] = SwitchColor(color, &seed, MSDF_COLOR_BLACK);
+            colors[1] = MSDF_COLOR_WHITE;
+            colors[2] = SwitchColor(colors[0], &seed, MSDF_COLOR_BLACK);
+            color = colors[2];
+            for (int i = 0; i < m; ++i)
+            {
+                int third = (int)(3 + 2.875f * i / (m - 1) - 1.4375f + 0.5f) - 3; // -1, 0, 1
+                edges[(first_corner + i) % m].m_Color = colors[1 + third];
+            }
+        }
+        else
+        {
+            // Switch color at each corner. The last corner must not get the initial color
+            color = SwitchColor(color, &seed, MSDF_COLOR_BLACK);
+            uint8_t initial_color = color;
+            int corner = 0;
+            for (int i = 0; i < m; ++i)
+            {
+                int index = (first_corner + i) % m;
+                if (i > 0 && IsCorner(edges[(index + m - 1) % m], edges[index]))
+                {
+                    ++corner;
+                    color = SwitchColor(color, &seed, corner == num_corners - 1 ? initial_color : (uint8_t)MSDF_COLOR_BLACK);
+                }
+                edges[index].m_Color = color;
+            }
+        }
+    }
+}
+
+// ****************************************************************************************************
+
+static inline uint8_t Median(uint8_t a, uint8_t b, uint8_t c)
+{
+    uint8_t lo = a < b ? a : b;
+    uint8_t hi = a < b ? b : a;
+    return c < lo ? lo : (c > hi ? hi : c);
+}
+
+static inline uint8_t ToValue(uint8_t edge, float pixel_dist_scale, float dist)
+{
+    float val = edge + pixel_dist_scale * dist;
+    if (val < 0)
+        val = 0;
+    else if (val > 255)
+        val = 255;
+    return (uint8_t) val;
+}
+
+MsdfShape* SdfCreateMsdfShape(const SdfShapeParams& params)
+{
+    int num_verts = params.m_NumVertices;
+    if (num_verts == 0 || params.m_Width <= 0 || params.m_Height <= 0)
+        return 0;
+
+    int max_contours;
+    int max_edges = CountEdges(params.m_Vertices, num_verts, &max_contours);
+
+    MsdfShape* shape = (MsdfShape*)ArenaAlloc(params.m_Arena, sizeof(MsdfShape));
+    memset(shape, 0, sizeof(*shape));
+    shape->m_Arena = params.m_Arena;
+    shape->m_Edges = (MsdfEdge*)ArenaAlloc(shape->m_Arena, max_edges * sizeof(MsdfEdge));
+    shape->m_Contours = (int*)ArenaAlloc(shape->m_Arena, (max_contours + 1) * sizeof(int));
+    shape->m_X0 = params.m_X0;
+    shape->m_Y0 = params.m_Y0;
+    shape->m_Width = params.m_Width;
+    shape->m_Height = params.m_Height;
+    shape->m_MaxDistance = params.m_MaxDistance;
+
+    AddEdges(shape, params.m_Vertices, num_verts, params.m_Scale);
+    ColorEdges(shape);
+    shape->m_Orientation = GetOrientation(shape);
+    return shape;
+}
+
+void SdfDeleteMsdfShape(MsdfShape* shape)
+{
+    if (!shape)
+        return;
+    // In reverse order, so that the arena can reclaim the memory
+    ArenaFree(shape->m_Arena, shape->m_Contours);
+    ArenaFree(shape->m_Arena, shape->m_Edges);
+    ArenaFree(shape->m_Arena, shape);
+}
+
+uint32_t SdfGetMsdfRowScratchSize(const MsdfShape* shape)
+{
+    return shape->m_NumEdges + 1 <= MSDF_STACK_ACTIVE_EDGES ? 0 : (shape->m_NumEdges + 1) * sizeof(int);
+}
+
+void SdfGenerateMsdfRows(MsdfShape* _shape, int row_start, int row_end, uint8_t edge, float pixel_dist_scale, uint8_t* out, void* scratch)
+{
+    const MsdfShape& shape = *_shape;
+    float max_distance = shape.m_MaxDistance;
+    int w = shape.m_Width;
+
+    // The edges within the max distance of the current row.
+    // The rows may be generated by several threads at once, so the buffer is the caller's scratch, or on the stack
+    int stack_active[MSDF_STACK_ACTIVE_EDGES];
+    int* active = stack_active;
+    if (shape.m_NumEdges + 1 > MSDF_STACK_ACTIVE_EDGES)
+        active = scratch ? (int*)scratch : (int*)malloc((shape.m_NumEdges + 1) * sizeof(int));
+
+    for (int row = row_start; row < row_end; ++row)
+    {
+        float py = (float) (shape.m_Y0 + row) + 0.5f;
+
+        int num_active = 0;
+        for (int i = 0; i < shape.m_NumEdges; ++i)
+        {
+            const MsdfEdge& e = shape.m_Edges[i];
+            if (py > e.m_MinY - max_distance && py < e.m_MaxY + max_distance)
+                active[num_active++] = i;
+        }
+
+        for (int col = 0; col < w; ++col)
+        {
+            float px = (float) (shape.m_X0 + col) + 0.5f;
+
+            float best_dist[3] = { max_distance, max_distance, max_distance };
+            float best_ortho[3] = { 1.0f, 1.0f, 1.0f };
+            float best_t[3] = { 0.0f, 0.0f, 0.0f };
+            int best_edge[3] = { -1, -1, -1 };
+
+            for (int a = 0; a < num_active; ++a)
+            {
+                int i = active[a];
+                const MsdfEdge& e = shape.m_Edges[i];
+
+                // Skip the edge if its bounding box is further away than the current distance of all its channels
+                float dx = e.m_MinX - px > px - e.m_MaxX ? e.m_MinX - px : px - e.m_MaxX;
+                float dy = e.m_MinY - py > py - e.m_MaxY ? e.m_MinY - py : py - e.m_MaxY;
+                dx = dx > 0.0f ? dx : 0.0f;
+                dy = dy > 0.0f ? dy : 0.0f;
+                float lower_bound2 = dx*dx + dy*dy;
+                bool candidate = false;
+                for (int c = 0; c < 3; ++c)
+                    candidate |= (e.m_Color & (1 << c)) && lower_bound2 <= (best_dist[c] + MSDF_EPSILON) * (best_dist[c] + MSDF_EPSILON);
+                if (!candidate)
+                    continue;
+
+                float t;
+                float dist = EdgeDistance(e, px, py, &t);
+                float ortho = -1.0f; // calculated when needed
+                for (int c = 0; c < 3; ++c)
+                {
+                    if (!(e.m_Color & (1 << c)))
+                        continue;
+
+                    bool closer = dist < best_dist[c] - MSDF_EPSILON;
+                    if (!closer && best_edge[c] >= 0 && fabsf(dist - best_dist[c]) <= MSDF_EPSILON)
+                    {
+                        // Edges meeting at a corner have the same distance, prefer the one facing the point
+                        if (ortho < 0.0f)
+                            ortho = EdgeOrthogonality(e, px, py, t);
+                        closer = ortho < best_ortho[c];
+                    }
+                    else if (closer)
+                    {
+                        ortho = ortho < 0.0f ? EdgeOrthogonality(e, px, py, t) : ortho;
+                    }
+
+                    if (closer)
+                    {
+                        best_dist[c] = dist;
+                        best_ortho[c] = ortho;
+                        best_t[c] = t;
+                        best_edge[c] = i;
+                    }
+                }
+            }
+
+            uint8_t* rgb = out + (row * w + col) * 3;
+            uint8_t value = rgb[0]; // The single channel sdf
+            bool inside = value >= edge;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                if (best_edge[c] < 0)
+                {
+                    rgb[c] = inside ? 255 : 0;
+                    continue;
+                }
+                const MsdfEdge& e = shape.m_Edges[best_edge[c]];
+                float sd = shape.m_Orientation * EdgePseudoDistance(e, px, py, best_t[c], best_dist[c]);
+                rgb[c] = ToValue(edge, pixel_dist_scale, sd);
+            }
+
+            if ((Median(rgb[0], rgb[1], rgb[2]) >= edge) != inside)
+            {
+                rgb[0] = value;
+                rgb[1] = value;
+                rgb[2] = value;
+            }
+        }
+    }
+
+    if (active != stack_active && active != scratch)
+        free(active);
+}
+
+} // namespace
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include "sdf.h"
+
+// The vectorized distance kernels. The best one is selected at runtime (see SdfSetKernel)
+#if defined(__x86_64__) || defined(_M_X64)
+    #define FONTGEN_SDF_SSE2
+    #if defined(__GNUC__) || defined(__clang__) // for __builtin_cpu_supports and the target pragmas
+        #define FONTGEN_SDF_AVX2
+    #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #define FONTGEN_SDF_NEON
+#endif
+
+namespace dmFontGen
+{
+    static const int SDF_CELL_SIZE = 8; // The size of a grid cell (in pixels). Also the number of pixels a distance kernel processes per call
+    static const int SDF_CUBIC_SUBDIVISIONS = 8; // The number of lines a cubic segment is flattened into
+
+    enum SdfSegmentType
+    {
+        SDF_SEGMENT_LINE,
+        SDF_SEGMENT_QUAD,
+    };
+
+    // The outline segment, used for the inside/outside test
+    struct SdfSegment
+    {
+        // Glyph space (y-up)
+        float   m_GX0, m_GY0;   // start point
+        float   m_GX1, m_GY1;   // control point (quads), end point (lines)
+        float   m_GX2, m_GY2;   // end point (quads)
+        uint8_t m_Type;
+    };
+
+    // The lines used by the distance kernels. Pixel space (y-down), structure of arrays
+    struct SdfLines
+    {
+        uint32_t    m_Count;
+        float*      m_X0;       // end point
+        float*      m_Y0;
+        float*      m_X1;       // start point
+        float*      m_Y1;
+        float*      m_InvLength;
+    };
+
+    // The quadratic curves used by the distance kernels. Pixel space (y-down), structure of arrays
+    struct SdfQuads
+    {
+        uint32_t    m_Count;
+        float*      m_X0;       // end point
+        float*      m_Y0;
+        float*      m_X1;       // control point
+        float*      m_Y1;
+        float*      m_X2;       // start point
+        float*      m_Y2;
+        float*      m_InvA;     // 1/|p0 - 2*p1 + p2|^2, or 0 if the curve is degenerate
+        float*      m_MinX;     // bounding box
+        float*      m_MinY;
+        float*      m_MaxX;
+        float*      m_MaxY;
+    };
+
+    // For each cell, the range [m_CellStart[i], m_CellStart[i+1]) of indices
+    struct SdfGrid
+    {
+        uint32_t*   m_CellStart;
+        uint16_t*   m_Indices;
+    };
+
+    /*
+     * Calculates the unsigned distance for SDF_CELL_SIZE consecutive pixels in a row, starting at pixel center (sx, sy).
+     * Only the segments of the grid cell are considered, and min_dist is expected to be initialized by the caller.
+     */
+    typedef void (*FSdfDistanceKernel)(const SdfShape* shape, int cell, float sx, float sy, float* min_dist);
+
+    struct SdfShape
+    {
+        SdfSegment* m_Segments;
+        int         m_NumSegments;
+
+        SdfLines    m_Lines;
+        SdfQuads    m_Quads;
+        float*      m_Floats;   // The memory for the lines and quads
+
+        float       m_Scale;
+        int         m_X0;
+        int         m_Y0;
+        int         m_Width;
+        int         m_Height;
+
+        int         m_CellsX;
+        int         m_CellsY;
+        SdfGrid     m_LineGrid;
+        SdfGrid     m_QuadGrid;
+
+        FSdfDistanceKernel m_Kernel;
+        Arena*      m_Arena;    // Where the memory was allocated
+    };
+
+    /*
+     * Solves x^3 + a*x^2 + b*x + c = 0 (see stbtt_GetGlyphSDF). Returns the number of roots written to r (max 3)
+     */
+    int SdfSolveCubic(float a, float b, float c, float* r);
+
+    void SdfDistanceKernelScalar(const SdfShape* shape, int cell, float sx, float sy, float* min_dist);
+#if defined(FONTGEN_SDF_SSE2)
+    void SdfDistanceKernelSSE2(const SdfShape* shape, int cell, float sx, float sy, float* min_dist);
+#endif
+#if defined(FONTGEN_SDF_AVX2)
+    void SdfDistanceKernelAVX2(const SdfShape* shape, int cell, float sx, float sy, float* min_dist);
+#endif
+#if defined(FONTGEN_SDF_NEON)
+    void SdfDistanceKernelNEON(const SdfShape* shape, int cell, float sx, float sy, float* min_dist);
+#endif
+}
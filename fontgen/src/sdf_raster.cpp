@@ -0,0 +1,208 @@
+// The raster signed distance field generator
+//
+// The glyph is rasterized (anti aliased) at SDF_RASTER_OVERSAMPLING times the output resolution,
+// and the distances to the inside and outside are calculated with an exact euclidean distance transform
+// ("Distance Transforms of Sampled Functions", Felzenszwalb & Huttenlocher).
+// The coverage of the edge pixels is used to place the edge within the pixel, which
+// keeps the error well below the oversampled pixel size.
+//
+// The cost is linear in the number of pixels, and doesn't depend on the complexity of the outline.
+// The output is an approximation of the analytic generator (see test/test_sdf.cpp)
+
+#include "sdf.h"
+#include "arena.h"
+
+#include <stdlib.h> // malloc
+#include <string.h> // memset
+#include <math.h>
+
+namespace dmFontGen
+{
+
+static const int   SDF_RASTER_OVERSAMPLING = 2;    // Must be even, see SdfGenerateRaster()
+static const float SDF_RASTER_INF = 1e20f;
+
+// The squared distance transform of the n values in row, in place
+// f, v and z are scratch buffers of size n, n and n+1. rcp[i] is 1/(2*i)
+static void DistanceTransformRow(float* row, int n, float* f, int* v, float* z, const float* rcp)
+{
+    v[0] = 0;
+    z[0] = -SDF_RASTER_INF;
+    z[1] = SDF_RASTER_INF;
+    f[0] = row[0];
+
+    // Find the lower envelope of the parabolas
+    int k = 0;
+    for (int q = 1; q < n; ++q)
+    {
+        f[q] = row[q];
+        float s;
+        do
+        {
+            int r = v[k];
+            s = (f[q] - f[r] + (float)(q*q - r*r)) * rcp[q - r];
+        } while (s <= z[k] && --k > -1);
+
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = SDF_RASTER_INF;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; ++q)
+    {
+        while (z[k+1] < q)
+            ++k;
+        int r = v[k];
+        row[q] = f[r] + (float)((q - r) * (q - r));
+    }
+}
+
+// The same as DistanceTransformRow() on each column, for input values that are either INF, or in the range [0, 0.25].
+// A sample further away than the nearest non INF sample (on either side) is then always at least
+// (d+1)^2 > d^2 + 0.25 away, so it's enough to find the nearest one in each direction.
+// The columns are processed together, row by row, to keep the memory accesses linear.
+static void DistanceTransformColumnsNearest(float* grid, int width, int height, int* nearest)
+{
+    for (int x = 0; x < width; ++x)
+        nearest[x] = -1;
+
+    for (int y = 0; y < height; ++y)
+    {
+        float* row = grid + y * width;
+        for (int x = 0; x < width; ++x)
+        {
+            if (row[x] < SDF_RASTER_INF)
+                nearest[x] = y;
+            else if (nearest[x] >= 0)
+                row[x] = grid[nearest[x] * width + x] + (float)((y - nearest[x]) * (y - nearest[x]));
+        }
+    }
+
+    // The forward pass only wrote to the INF samples, and those are now larger than 0.25
+    for (int x = 0; x < width; ++x)
+        nearest[x] = -1;
+
+    for (int y = height - 1; y >= 0; --y)
+    {
+        float* row = grid + y * width;
+        for (int x = 0; x < width; ++x)
+        {
+            if (row[x] <= 0.25f)
+                nearest[x] = y;
+            else if (nearest[x] >= 0)
+            {
+                float d = grid[nearest[x] * width + x] + (float)((y - nearest[x]) * (y - nearest[x]));
+                if (d < row[x])
+                    row[x] = d;
+            }
+        }
+    }
+}
+
+bool SdfGenerateRaster(const SdfShapeParams& params, uint8_t edge, float pixel_dist_scale, void* userdata, uint8_t* out, int stride)
+{
+    const int N = SDF_RASTER_OVERSAMPLING;
+    int width = params.m_Width;
+    int height = params.m_Height;
+    float scale = params.m_Scale;
+
+    // The oversampled image has a border of one pixel, so that shapes touching the edge have an outside
+    int bw = width * N + 2;
+    int bh = height * N + 2;
+
+    if (params.m_NumVertices == 0)
+        return false;
+
+    int n = bw > bh ? bw : bh;
+    uint32_t num_pixels = bw * bh;
+    uint8_t* mem = (uint8_t*)ArenaAlloc(params.m_Arena, num_pixels * (1 + 2 * sizeof(float)) + n * (3 * sizeof(float) + sizeof(int)) + sizeof(float));
+    float* outer = (float*)mem;         // squared distance to the inside
+    float* inner = outer + num_pixels;  // squared distance to the outside
+    float* f = inner + num_pixels;
+    float* z = f + n;
+    float* rcp = z + n + 1;
+    int* v = (int*)(rcp + n);
+    uint8_t* coverage = (uint8_t*)(v + n);
+
+    rcp[0] = 0.0f;
+    for (int i = 1; i < n; ++i)
+        rcp[i] = 0.5f / i;
+
+    // Rasterize the whole image, as the outline may extend outside the glyph bounding box (and into the padding)
+    memset(coverage, 0, num_pixels);
+    stbtt__bitmap bitmap;
+    bitmap.w = width * N;
+    bitmap.h = height * N;
+    bitmap.stride = bw;
+    bitmap.pixels = coverage + bw + 1;
+    stbtt_Rasterize(&bitmap, 0.35f, (stbtt_vertex*)params.m_Vertices, params.m_NumVertices, scale * N, scale * N, 0.0f, 0.0f,
+                    params.m_X0 * N, params.m_Y0 * N, 1, userdata);
+
+    for (uint32_t i = 0; i < num_pixels; ++i)
+    {
+        float a = coverage[i] / 255.0f;
+        if (coverage[i] == 255)
+        {
+            outer[i] = 0.0f;
+            inner[i] = SDF_RASTER_INF;
+        }
+        else if (coverage[i] == 0)
+        {
+            outer[i] = SDF_RASTER_INF;
+            inner[i] = 0.0f;
+        }
+        else
+        {
+            // An edge pixel, approximate the distance from the pixel center to the edge with the coverage
+            float d_out = a < 0.5f ? 0.5f - a : 0.0f;
+            float d_in = a > 0.5f ? a - 0.5f : 0.0f;
+            outer[i] = d_out * d_out;
+            inner[i] = d_in * d_in;
+        }
+    }
+
+    DistanceTransformColumnsNearest(outer, bw, bh, v);
+    DistanceTransformColumnsNearest(inner, bw, bh, v);
+
+    // The center of an output pixel is in between the two middle samples (of N) on each axis,
+    // so only those rows need the horizontal pass
+    for (int y = 0; y < height; ++y)
+    {
+        int sy = 1 + y * N + N / 2 - 1;
+        for (int r = sy; r < sy + 2; ++r)
+        {
+            DistanceTransformRow(outer + r * bw, bw, f, v, z, rcp);
+            DistanceTransformRow(inner + r * bw, bw, f, v, z, rcp);
+        }
+
+        uint8_t* out_row = out + y * width * stride;
+        for (int x = 0; x < width; ++x)
+        {
+            int sx = 1 + x * N + N / 2 - 1;
+            float dist = 0.0f;
+            for (int r = sy; r < sy + 2; ++r)
+            {
+                for (int c = sx; c < sx + 2; ++c)
+                {
+                    uint32_t i = r * bw + c;
+                    dist += sqrtf(inner[i]) - sqrtf(outer[i]);
+                }
+            }
+            dist = dist * 0.25f / N; // average, and convert to output pixels
+
+            float val = edge + pixel_dist_scale * dist;
+            if (val < 0)
+                val = 0;
+            else if (val > 255)
+                val = 255;
+            out_row[x * stride] = (uint8_t) val;
+        }
+    }
+
+    ArenaFree(params.m_Arena, mem);
+    return true;
+}
+
+} // namespace
@@ -0,0 +1,107 @@
+// The SSE2 (x86-64) and NEON (arm64) distance kernels, see sdf_kernel.h
+
+#include "sdf_private.h"
+
+#include <math.h>
+
+#if defined(FONTGEN_SDF_SSE2)
+    #include <emmintrin.h>
+#endif
+#if defined(FONTGEN_SDF_NEON)
+    #include <arm_neon.h>
+#endif
+
+#include "sdf_kernel.h"
+
+namespace dmFontGen
+{
+
+#if defined(FONTGEN_SDF_SSE2)
+struct VecSSE2
+{
+    typedef __m128 F;
+    typedef __m128 M;
+    enum { WIDTH = 4 };
+
+    static inline F Set1(float v)               { return _mm_set1_ps(v); }
+    static inline F Zero()                      { return _mm_setzero_ps(); }
+    static inline F Lanes()                     { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+    static inline F Load(const float* p)        { return _mm_loadu_ps(p); }
+    static inline void Store(float* p, F v)     { _mm_storeu_ps(p, v); }
+
+    static inline F Add(F a, F b)               { return _mm_add_ps(a, b); }
+    static inline F Sub(F a, F b)               { return _mm_sub_ps(a, b); }
+    static inline F Mul(F a, F b)               { return _mm_mul_ps(a, b); }
+    static inline F Div(F a, F b)               { return _mm_div_ps(a, b); }
+    static inline F Sqrt(F a)                   { return _mm_sqrt_ps(a); }
+    static inline F Abs(F a)                    { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static inline F Neg(F a)                    { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+
+    static inline M Lt(F a, F b)                { return _mm_cmplt_ps(a, b); }
+    static inline M Le(F a, F b)                { return _mm_cmple_ps(a, b); }
+    static inline M Gt(F a, F b)                { return _mm_cmpgt_ps(a, b); }
+    static inline M Ge(F a, F b)                { return _mm_cmpge_ps(a, b); }
+    static inline M Eq(F a, F b)                { return _mm_cmpeq_ps(a, b); }
+    static inline M True()                      { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+    static inline M False()                     { return _mm_setzero_ps(); }
+    static inline M And(M a, M b)               { return _mm_and_ps(a, b); }
+    static inline M Not(M a)                    { return _mm_xor_ps(a, True()); }
+    static inline bool Any(M a)                 { return _mm_movemask_ps(a) != 0; }
+    static inline F Select(M m, F a, F b)       { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+    // The integer value of the bits of a float, and vice versa
+    static inline F BitsToValue(F a)            { return _mm_cvtepi32_ps(_mm_castps_si128(a)); }
+    static inline F ValueToBits(F a)            { return _mm_castsi128_ps(_mm_cvtps_epi32(a)); }
+};
+
+void SdfDistanceKernelSSE2(const SdfShape* shape, int cell, float sx, float sy, float* min_dist)
+{
+    SdfDistanceKernel<VecSSE2>(shape, cell, sx, sy, min_dist);
+}
+#endif
+
+#if defined(FONTGEN_SDF_NEON)
+struct VecNEON
+{
+    typedef float32x4_t F;
+    typedef uint32x4_t  M;
+    enum { WIDTH = 4 };
+
+    static inline F Set1(float v)               { return vdupq_n_f32(v); }
+    static inline F Zero()                      { return vdupq_n_f32(0.0f); }
+    static inline F Lanes()                     { static const float lanes[4] = { 0.0f, 1.0f, 2.0f, 3.0f }; return vld1q_f32(lanes); }
+    static inline F Load(const float* p)        { return vld1q_f32(p); }
+    static inline void Store(float* p, F v)     { vst1q_f32(p, v); }
+
+    static inline F Add(F a, F b)               { return vaddq_f32(a, b); }
+    static inline F Sub(F a, F b)               { return vsubq_f32(a, b); }
+    static inline F Mul(F a, F b)               { return vmulq_f32(a, b); }
+    static inline F Div(F a, F b)               { return vdivq_f32(a, b); }
+    static inline F Sqrt(F a)                   { return vsqrtq_f32(a); }
+    static inline F Abs(F a)                    { return vabsq_f32(a); }
+    static inline F Neg(F a)                    { return vnegq_f32(a); }
+
+    static inline M Lt(F a, F b)                { return vcltq_f32(a, b); }
+    static inline M Le(F a, F b)                { return vcleq_f32(a, b); }
+    static inline M Gt(F a, F b)                { return vcgtq_f32(a, b); }
+    static inline M Ge(F a, F b)                { return vcgeq_f32(a, b); }
+    static inline M Eq(F a, F b)                { return vceqq_f32(a, b); }
+    static inline M True()                      { return vdupq_n_u32(0xFFFFFFFF); }
+    static inline M False()                     { return vdupq_n_u32(0); }
+    static inline M And(M a, M b)               { return vandq_u32(a, b); }
+    static inline M Not(M a)                    { return vmvnq_u32(a); }
+    static inline bool Any(M a)                 { return vmaxvq_u32(a) != 0; }
+    static inline F Select(M m, F a, F b)       { return vbslq_f32(m, a, b); }
+
+    // The integer value of the bits of a float, and vice versa
+    static inline F BitsToValue(F a)            { return vcvtq_f32_s32(vreinterpretq_s32_f32(a)); }
+    static inline F ValueToBits(F a)            { return vreinterpretq_f32_s32(vcvtnq_s32_f32(a)); }
+};
+
+void SdfDistanceKernelNEON(const SdfShape* shape, int cell, float sx, float sy, float* min_dist)
+{
+    SdfDistanceKernel<VecNEON>(shape, cell, sx, sy, min_dist);
+}
+#endif
+
+} // namespace
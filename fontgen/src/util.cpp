@@ -1,6 +1,12 @@
 #include "util.h"
 #include <stdio.h>
 
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <unistd.h> // sysconf
+#endif
+
 namespace dmFontGen
 {
 
@@ -18,4 +24,16 @@ void DebugPrintBitmap(uint8_t* bitmap, int w, int h)
     printf("--------------------------------------------\n");
 }
 
+uint32_t GetCpuCount()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long count = (long)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? (uint32_t)count : 1;
+}
+
 } // namespace
@@ -8,4 +8,9 @@ namespace dmFontGen
      * Outputs a w*h single channel bitmap to stdout
      */
     void DebugPrintBitmap(uint8_t* bitmap, int w, int h);
+
+    /*
+     * Gets the number of online cpu cores (at least 1)
+     */
+    uint32_t GetCpuCount();
 }
@@ -0,0 +1,165 @@
+// Measures the glyph generation throughput with 1, 2, 4 and 8 worker threads
+// Usage: bench_workers <font.ttf> [<size>] [<algorithm>]
+// The workers pull glyphs from a shared counter, and use their own arena for the stb_truetype
+// scratch memory, the same way as the worker pool in fontgen.cpp (see fontgen.worker_threads)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "arena.h"
+#include "sdf.h"
+
+#define STBTT_malloc(x,u)  dmFontGen::ArenaAlloc((dmFontGen::Arena*)(u), x)
+#define STBTT_free(x,u)    dmFontGen::ArenaFree((dmFontGen::Arena*)(u), x)
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+using namespace dmFontGen;
+
+static const int NUM_ROUNDS = 3; // Each round generates all glyphs in the font
+
+struct BenchContext
+{
+    const stbtt_fontinfo*   m_Font;
+    float                   m_Scale;
+    int                     m_Padding;
+    int                     m_Edge;
+    SdfAlgorithm            m_Algorithm;
+    int                     m_NumItems;
+    std::atomic<int>        m_Next;
+};
+
+static unsigned char* ReadFile(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char* data = (unsigned char*)malloc(size);
+    fread(data, 1, size, f);
+    fclose(f);
+    return data;
+}
+
+static void GenerateGlyph(BenchContext* ctx, stbtt_fontinfo* font, int glyph)
+{
+    float pixel_dist_scale = (float)ctx->m_Edge/(float)ctx->m_Padding;
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBoxSubpixel(font, glyph, ctx->m_Scale, ctx->m_Scale, 0.0f, 0.0f, &x0, &y0, &x1, &y1);
+    if (x0 == x1 || y0 == y1)
+        return;
+
+    stbtt_vertex* verts = 0;
+    int num_verts = stbtt_GetGlyphShape(font, glyph, &verts);
+
+    SdfShapeParams params;
+    params.m_Vertices       = verts;
+    params.m_NumVertices    = num_verts;
+    params.m_Scale          = ctx->m_Scale;
+    params.m_X0             = x0 - ctx->m_Padding;
+    params.m_Y0             = y0 - ctx->m_Padding;
+    params.m_Width          = x1 - x0 + 2 * ctx->m_Padding;
+    params.m_Height         = y1 - y0 + 2 * ctx->m_Padding;
+    params.m_MaxDistance    = SdfGetMaxDistance(ctx->m_Edge, pixel_dist_scale);
+    params.m_Arena          = (Arena*)font->userdata;
+
+    int channels = ctx->m_Algorithm == SDF_ALGORITHM_MSDF ? 3 : 1;
+    uint8_t* out = (uint8_t*)malloc(params.m_Width * params.m_Height * channels);
+    if (ctx->m_Algorithm == SDF_ALGORITHM_RASTER)
+    {
+        SdfGenerateRaster(params, ctx->m_Edge, pixel_dist_scale, font->userdata, out, 1);
+    }
+    else
+    {
+        SdfShape* shape = SdfCreateShape(params);
+        SdfGenerateRows(shape, 0, params.m_Height, ctx->m_Edge, pixel_dist_scale, out, channels, 0);
+        SdfDeleteShape(shape);
+        if (ctx->m_Algorithm == SDF_ALGORITHM_MSDF)
+        {
+            MsdfShape* msdf = SdfCreateMsdfShape(params);
+            SdfGenerateMsdfRows(msdf, 0, params.m_Height, ctx->m_Edge, pixel_dist_scale, out, 0);
+            SdfDeleteMsdfShape(msdf);
+        }
+    }
+    free(out);
+    stbtt_FreeShape(font, verts);
+}
+
+static void Worker(BenchContext* ctx)
+{
+    // A shallow copy, so that the stb_truetype allocations go to the arena of this worker
+    stbtt_fontinfo font = *ctx->m_Font;
+    Arena* arena = ArenaCreate(64 * 1024);
+    font.userdata = arena;
+
+    while (true)
+    {
+        int item = ctx->m_Next++;
+        if (item >= ctx->m_NumItems)
+            break;
+        GenerateGlyph(ctx, &font, item % font.numGlyphs);
+        ArenaReset(arena);
+    }
+    ArenaDelete(arena);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <font.ttf> [<size>] [analytic|raster|msdf]\n", argv[0]);
+        return 1;
+    }
+
+    unsigned char* data = ReadFile(argv[1]);
+    if (!data)
+    {
+        printf("Failed to read %s\n", argv[1]);
+        return 1;
+    }
+    int size = argc > 2 ? atoi(argv[2]) : 64;
+    const char* algorithm = argc > 3 ? argv[3] : "analytic";
+
+    stbtt_fontinfo font;
+    stbtt_InitFont(&font, data, stbtt_GetFontOffsetForIndex(data, 0));
+
+    BenchContext ctx;
+    ctx.m_Font      = &font;
+    ctx.m_Scale     = stbtt_ScaleForPixelHeight(&font, size);
+    ctx.m_Padding   = 3;
+    ctx.m_Edge      = 190;
+    ctx.m_Algorithm = strcmp(algorithm, "raster") == 0 ? SDF_ALGORITHM_RASTER : (strcmp(algorithm, "msdf") == 0 ? SDF_ALGORITHM_MSDF : SDF_ALGORITHM_ANALYTIC);
+    ctx.m_NumItems  = font.numGlyphs * NUM_ROUNDS;
+
+    printf("%s size: %d algorithm: %s glyphs: %d cores: %u\n", argv[1], size, algorithm, ctx.m_NumItems, std::thread::hardware_concurrency());
+
+    const int worker_counts[] = { 1, 2, 4, 8 };
+    double base_rate = 0.0;
+    for (int i = 0; i < (int)(sizeof(worker_counts)/sizeof(worker_counts[0])); ++i)
+    {
+        int num_workers = worker_counts[i];
+        ctx.m_Next = 0;
+
+        std::chrono::steady_clock::time_point tstart = std::chrono::steady_clock::now();
+        std::thread threads[8];
+        for (int t = 0; t < num_workers; ++t)
+            threads[t] = std::thread(Worker, &ctx);
+        for (int t = 0; t < num_workers; ++t)
+            threads[t].join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tstart).count();
+
+        double rate = ctx.m_NumItems / seconds;
+        if (i == 0)
+            base_rate = rate;
+        printf("workers: %d  time: %.3f s  glyphs/s: %.0f  speedup: %.2fx\n", num_workers, seconds, rate, rate / base_rate);
+    }
+
+    free(data);
+    return 0;
+}
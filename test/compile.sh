@@ -1,8 +1,28 @@
 #!/usr/bin/env bash
 
 DIR=$(dirname "$0")
+SRC=${DIR}/../fontgen/src
 TARGET=${DIR}/generator
 
-clang -I${DIR}/../fontext/src ${DIR}/main.c -o ${TARGET}
+clang -I${SRC} ${DIR}/main.c -o ${TARGET}
 echo "Wrote ${TARGET}"
 echo "Run with: ${TARGET} C 14 ./assets/fonts/vera_mo_bd.ttf"
+
+TEST_TARGET=${DIR}/test_sdf
+
+clang++ -O2 -I${SRC} ${DIR}/test_sdf.cpp ${SRC}/arena.cpp ${SRC}/sdf.cpp ${SRC}/sdf_raster.cpp ${SRC}/sdf_msdf.cpp ${SRC}/sdf_simd.cpp ${SRC}/sdf_avx2.cpp -o ${TEST_TARGET}
+echo "Wrote ${TEST_TARGET}"
+echo "Run with: ${TEST_TARGET} ./assets/fonts/Roboto/*.ttf"
+
+BENCH_TARGET=${DIR}/bench_workers
+
+clang++ -O2 -std=c++11 -pthread -I${SRC} ${DIR}/bench_workers.cpp ${SRC}/arena.cpp ${SRC}/sdf.cpp ${SRC}/sdf_raster.cpp ${SRC}/sdf_msdf.cpp ${SRC}/sdf_simd.cpp ${SRC}/sdf_avx2.cpp -o ${BENCH_TARGET}
+echo "Wrote ${BENCH_TARGET}"
+echo "Run with: ${BENCH_TARGET} ./assets/fonts/Roboto/Roboto-Regular.ttf 64"
+
+QUEUE_TEST_TARGET=${DIR}/test_job_queue
+
+# The dmsdk atomics come from ${DIR}/dmsdk, outside of the engine
+clang++ -O2 -std=c++11 -pthread -I${DIR} -I${SRC} ${DIR}/test_job_queue.cpp -o ${QUEUE_TEST_TARGET}
+echo "Wrote ${QUEUE_TEST_TARGET}"
+echo "Run with: ${QUEUE_TEST_TARGET}"
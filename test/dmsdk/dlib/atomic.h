@@ -0,0 +1,21 @@
+#pragma once
+
+// The atomics of the Defold sdk, for the standalone tests (see compile.sh).
+// Same semantics as dlib: the functions return the value before the operation
+
+#include <stdint.h>
+
+typedef int32_t int32_atomic_t;
+
+static inline int32_t dmAtomicIncrement32(int32_atomic_t* ptr)     { return __atomic_fetch_add(ptr, 1, __ATOMIC_SEQ_CST); }
+static inline int32_t dmAtomicDecrement32(int32_atomic_t* ptr)     { return __atomic_fetch_sub(ptr, 1, __ATOMIC_SEQ_CST); }
+static inline int32_t dmAtomicAdd32(int32_atomic_t* ptr, int32_t value) { return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST); }
+static inline int32_t dmAtomicSub32(int32_atomic_t* ptr, int32_t value) { return __atomic_fetch_sub(ptr, value, __ATOMIC_SEQ_CST); }
+static inline int32_t dmAtomicStore32(int32_atomic_t* ptr, int32_t value) { return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST); }
+static inline int32_t dmAtomicGet32(int32_atomic_t* ptr)           { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+
+static inline int32_t dmAtomicCompareStore32(int32_atomic_t* ptr, int32_t value, int32_t comparand)
+{
+    __atomic_compare_exchange_n(ptr, &comparand, value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand; // The old value, whether or not it was stored
+}
@@ -0,0 +1,113 @@
+// Stress tests of the lock free job queue (see job_queue.h)
+// Usage: test_job_queue
+// Producers push unique items into a small queue, so that it's often full or empty, while consumers pop them.
+// Every item must be popped exactly once. Returns non zero if any test fails
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "job_queue.h"
+
+using namespace dmFontGen;
+
+static const uint32_t QUEUE_CAPACITY = 64;
+static const uint32_t ITEMS_PER_PRODUCER = 1 << 20; // The positions of the queue wrap around its capacity many times
+
+struct StressContext
+{
+    JobQueue<uint32_t>      m_Queue;
+    uint32_t                m_NumItems;
+    std::atomic<uint32_t>   m_NumPopped;
+    uint8_t*                m_Seen;     // The number of times each item was popped
+};
+
+static void Produce(StressContext* ctx, uint32_t producer)
+{
+    for (uint32_t i = 0; i < ITEMS_PER_PRODUCER; ++i)
+    {
+        uint32_t item = producer * ITEMS_PER_PRODUCER + i;
+        while (!ctx->m_Queue.Push(item))
+            std::this_thread::yield(); // Full
+    }
+}
+
+static void Consume(StressContext* ctx, bool single_consumer)
+{
+    while (ctx->m_NumPopped.load() < ctx->m_NumItems)
+    {
+        uint32_t item;
+        bool popped = single_consumer ? ctx->m_Queue.PopSingleConsumer(&item) : ctx->m_Queue.Pop(&item);
+        if (!popped)
+        {
+            std::this_thread::yield(); // Empty
+            continue;
+        }
+        if (item < ctx->m_NumItems)
+            ctx->m_Seen[item]++; // Each item is only popped by one consumer
+        ctx->m_NumPopped++;
+    }
+}
+
+// Returns true if every item was popped exactly once
+static bool RunStress(const char* name, uint32_t num_producers, uint32_t num_consumers)
+{
+    StressContext ctx;
+    ctx.m_Queue.SetCapacity(QUEUE_CAPACITY);
+    ctx.m_NumItems = num_producers * ITEMS_PER_PRODUCER;
+    ctx.m_NumPopped = 0;
+    ctx.m_Seen = (uint8_t*)malloc(ctx.m_NumItems);
+    memset(ctx.m_Seen, 0, ctx.m_NumItems);
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < num_consumers; ++i)
+        threads.push_back(std::thread(Consume, &ctx, num_consumers == 1));
+    for (uint32_t i = 0; i < num_producers; ++i)
+        threads.push_back(std::thread(Produce, &ctx, i));
+    for (uint32_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    uint32_t missing = 0;
+    uint32_t duplicates = 0;
+    for (uint32_t i = 0; i < ctx.m_NumItems; ++i)
+    {
+        missing += ctx.m_Seen[i] == 0 ? 1 : 0;
+        duplicates += ctx.m_Seen[i] > 1 ? 1 : 0;
+    }
+    bool ok = missing == 0 && duplicates == 0 && ctx.m_Queue.Empty();
+    printf("%s %s items: %u missing: %u duplicates: %u\n", ok ? "OK  " : "FAIL", name, ctx.m_NumItems, missing, duplicates);
+    free(ctx.m_Seen);
+    return ok;
+}
+
+// The queue is full at its capacity, and empty again when all items are popped
+static bool RunBounds()
+{
+    JobQueue<uint32_t> queue;
+    queue.SetCapacity(QUEUE_CAPACITY);
+    bool ok = true;
+    for (uint32_t i = 0; i < QUEUE_CAPACITY; ++i)
+        ok &= queue.Push(i);
+    ok &= !queue.Push(QUEUE_CAPACITY) && queue.Size() == QUEUE_CAPACITY;
+    for (uint32_t i = 0; i < QUEUE_CAPACITY; ++i)
+    {
+        uint32_t item;
+        ok &= queue.Pop(&item) && item == i; // First in, first out
+    }
+    uint32_t item;
+    ok &= !queue.Pop(&item) && queue.Empty();
+    printf("%s bounds capacity: %u\n", ok ? "OK  " : "FAIL", QUEUE_CAPACITY);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int failures = 0;
+    failures += RunBounds() ? 0 : 1;
+    failures += RunStress("4 producers / 4 consumers", 4, 4) ? 0 : 1;
+    failures += RunStress("4 producers / 1 consumer", 4, 1) ? 0 : 1;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,278 @@
+// Compares the fontgen sdf generator against stbtt_GetGlyphSDF()
+// Usage: test_sdf <font.ttf> [<font.ttf> ...]
+// Returns non zero if any pixel differs more than the tolerance.
+// The raster generator is an approximation, and is instead checked against a mean error
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sdf.h"
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+using namespace dmFontGen;
+
+static const int TOLERANCE = 1; // see sdf.cpp and sdf_kernel.h
+static const float RASTER_MEAN_TOLERANCE = 0.15f; // In pixels. The raster generator is an approximation, see sdf_raster.cpp
+
+static const int NUM_GENERATORS = SDF_KERNEL_NEON + 2; // The analytic kernels, and the raster generator
+static const int GENERATOR_RASTER = SDF_KERNEL_NEON + 1;
+
+static int g_RowSliceMismatches = 0; // Glyphs where generating one row at a time differs from generating all rows at once
+static int g_SharedFieldMismatches = 0; // Glyphs where quantizing a distance field with a larger padding differs from generating the sdf directly
+static const int SHARED_EXTRA_PADDING = 5;
+static int g_BlurMaxDiff = 0; // The max difference between the separable blur and a direct 2d gaussian blur
+static const float BLUR_RADIUS = 2.5f;
+static long g_MsdfPixels = 0;
+static long g_MsdfSignMismatches = 0; // Pixels where the median of the msdf is on the other side of the edge than the sdf
+static long g_MsdfFallbacks = 0; // Pixels where the error correction replaced the msdf with the sdf (see sdf_msdf.cpp)
+static const float MSDF_FALLBACK_TOLERANCE = 0.05f; // The max ratio of fallbacks to the pixels near the edge
+static long g_MsdfEdgePixels = 0;
+
+static unsigned char* ReadFile(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char* data = (unsigned char*)malloc(size);
+    fread(data, 1, size, f);
+    fclose(f);
+    return data;
+}
+
+struct Stats
+{
+    long    m_Pixels;
+    long    m_Differing;
+    long    m_TotalDiff;
+    int     m_MaxDiff;
+};
+
+static void AddStats(const unsigned char* expected, const unsigned char* actual, int count, Stats* stats)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        int diff = abs(actual[i] - expected[i]);
+        stats->m_Pixels++;
+        stats->m_TotalDiff += diff;
+        if (diff)
+            stats->m_Differing++;
+        if (diff > stats->m_MaxDiff)
+            stats->m_MaxDiff = diff;
+    }
+}
+
+// A direct (non separable) gaussian blur, with the same kernel and border handling as SdfBlur()
+static void BlurReference(const unsigned char* in, int w, int h, float radius, unsigned char* out)
+{
+    int half = (int)ceilf(radius);
+    float sigma = radius / 3.0f;
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            float sum = 0.0f;
+            float total = 0.0f;
+            for (int j = -half; j <= half; ++j)
+            {
+                for (int i = -half; i <= half; ++i)
+                {
+                    int sx = x + i < 0 ? 0 : (x + i >= w ? w - 1 : x + i);
+                    int sy = y + j < 0 ? 0 : (y + j >= h ? h - 1 : y + j);
+                    float weight = expf(-(i*i + j*j) / (2.0f * sigma * sigma));
+                    sum += weight * in[sy * w + sx];
+                    total += weight;
+                }
+            }
+            out[y * w + x] = (unsigned char)(sum / total + 0.5f);
+        }
+    }
+}
+
+// Compares all supported kernels, and the raster generator, against the stb output
+static void CompareGlyph(const stbtt_fontinfo* font, int glyph, float scale, int padding, int edge, Stats* stats)
+{
+    float pixel_dist_scale = (float)edge/(float)padding;
+
+    int w, h, xoff, yoff;
+    unsigned char* expected = stbtt_GetGlyphSDF(font, scale, glyph, padding, edge, pixel_dist_scale, &w, &h, &xoff, &yoff);
+    if (!expected)
+        return;
+
+    stbtt_vertex* verts = 0;
+    int num_verts = stbtt_GetGlyphShape(font, glyph, &verts);
+    unsigned char* actual = (unsigned char*)malloc(w*h);
+
+    SdfShapeParams params;
+    params.m_Vertices       = verts;
+    params.m_NumVertices    = num_verts;
+    params.m_Scale          = scale;
+    params.m_X0             = xoff;
+    params.m_Y0             = yoff;
+    params.m_Width          = w;
+    params.m_Height         = h;
+    params.m_MaxDistance    = SdfGetMaxDistance(edge, pixel_dist_scale);
+    params.m_Arena          = 0;
+
+    for (int k = SDF_KERNEL_SCALAR; k <= SDF_KERNEL_NEON; ++k)
+    {
+        if (!SdfSetKernel((SdfKernel)k))
+            continue;
+
+        SdfShape* shape = SdfCreateShape(params);
+        SdfGenerateRows(shape, 0, h, edge, pixel_dist_scale, actual, 1, 0);
+        SdfDeleteShape(shape);
+
+        AddStats(expected, actual, w*h, &stats[k]);
+    }
+
+    if (SdfGenerateRaster(params, edge, pixel_dist_scale, font->userdata, actual, 1))
+        AddStats(expected, actual, w*h, &stats[GENERATOR_RASTER]);
+
+    // The resumable generation (see StepGlyphSdf() in res_ttf.cpp) may stop after any row
+    SdfSetKernel(SDF_KERNEL_AUTO);
+    unsigned char* sliced = (unsigned char*)malloc(w*h);
+    SdfShape* shape = SdfCreateShape(params);
+    SdfGenerateRows(shape, 0, h, edge, pixel_dist_scale, actual, 1, 0);
+    uint32_t scratch_size = SdfGetRowScratchSize(shape);
+    void* scratch = scratch_size ? malloc(scratch_size) : 0; // As the bands of res_ttf.cpp
+    for (int y = 0; y < h; ++y)
+        SdfGenerateRows(shape, y, y + 1, edge, pixel_dist_scale, sliced, 1, scratch);
+    free(scratch);
+    SdfDeleteShape(shape);
+    if (memcmp(actual, sliced, w*h) != 0)
+        g_RowSliceMismatches++;
+    free(sliced);
+
+    // Fonts sharing a ttf and scale share one distance field, generated with the largest padding (see res_ttf.cpp)
+    SdfShapeParams shared_params = params;
+    int e = SHARED_EXTRA_PADDING;
+    shared_params.m_X0 -= e;
+    shared_params.m_Y0 -= e;
+    shared_params.m_Width += 2*e;
+    shared_params.m_Height += 2*e;
+    float shared_max_distance = SdfGetMaxDistance(edge, (float)edge/(float)(padding + e));
+    if (shared_max_distance > params.m_MaxDistance)
+        shared_params.m_MaxDistance = shared_max_distance;
+    float* distances = (float*)malloc(shared_params.m_Width * shared_params.m_Height * sizeof(float));
+    unsigned char* quantized = (unsigned char*)malloc(w*h);
+    shape = SdfCreateShape(shared_params);
+    SdfGenerateDistanceRows(shape, 0, shared_params.m_Height, distances, 0);
+    SdfDeleteShape(shape);
+    SdfQuantizeDistances(distances, shared_params.m_Width, e, e, w, h, edge, pixel_dist_scale, quantized, 1);
+    if (memcmp(actual, quantized, w*h) != 0)
+        g_SharedFieldMismatches++;
+    free(quantized);
+    free(distances);
+
+    // The median of the msdf must agree with the sdf on the inside, and the edge coloring must make most pixels usable
+    MsdfShape* msdf = SdfCreateMsdfShape(params);
+    unsigned char* msdf_rgb = (unsigned char*)malloc(w*h*3);
+    shape = SdfCreateShape(params);
+    SdfGenerateRows(shape, 0, h, edge, pixel_dist_scale, msdf_rgb, 3, 0);
+    SdfDeleteShape(shape);
+    SdfGenerateMsdfRows(msdf, 0, h, edge, pixel_dist_scale, msdf_rgb, 0);
+    SdfDeleteMsdfShape(msdf);
+    for (int i = 0; i < w*h; ++i)
+    {
+        const unsigned char* c = &msdf_rgb[i*3];
+        int lo = c[0] < c[1] ? c[0] : c[1];
+        int hi = c[0] < c[1] ? c[1] : c[0];
+        int median = c[2] < lo ? lo : (c[2] > hi ? hi : c[2]);
+        g_MsdfPixels++;
+        if ((median >= edge) != (actual[i] >= edge))
+            g_MsdfSignMismatches++;
+        if (actual[i] == 0 || actual[i] == 255)
+            continue;
+        g_MsdfEdgePixels++;
+        if (c[0] == actual[i] && c[1] == actual[i] && c[2] == actual[i])
+            g_MsdfFallbacks++;
+    }
+    free(msdf_rgb);
+
+    // The shadow channel of multi layer fonts is a blur of the sdf channel (see fontgen.cpp)
+    unsigned char* rgb = (unsigned char*)malloc(w*h*3);
+    unsigned char* blurred = (unsigned char*)malloc(w*h);
+    for (int i = 0; i < w*h; ++i)
+        rgb[i*3] = actual[i];
+    SdfBlur(rgb, w, h, 3, 0, 2, BLUR_RADIUS, 0);
+    BlurReference(actual, w, h, BLUR_RADIUS, blurred);
+    for (int i = 0; i < w*h; ++i)
+    {
+        int diff = abs((int)rgb[i*3 + 2] - (int)blurred[i]);
+        g_BlurMaxDiff = diff > g_BlurMaxDiff ? diff : g_BlurMaxDiff;
+        if (rgb[i*3] != actual[i])
+            g_BlurMaxDiff = 255; // The source channel must be left intact
+    }
+    free(blurred);
+    free(rgb);
+
+    free(actual);
+    stbtt_FreeShape(font, verts);
+    stbtt_FreeSDF(expected, 0);
+}
+
+int main(int argc, char** argv)
+{
+    const char* generator_names[] = { "auto", "scalar", "sse2", "avx2", "neon", "raster" };
+    const int sizes[] = { 28, 64 };
+    const int paddings[] = { 3, 15 };
+    const int edge = 190;
+
+    int failures = 0;
+    for (int f = 1; f < argc; ++f)
+    {
+        unsigned char* data = ReadFile(argv[f]);
+        if (!data)
+        {
+            printf("Failed to read %s\n", argv[f]);
+            return 1;
+        }
+
+        stbtt_fontinfo font;
+        stbtt_InitFont(&font, data, stbtt_GetFontOffsetForIndex(data, 0));
+
+        for (int s = 0; s < (int)(sizeof(sizes)/sizeof(sizes[0])); ++s)
+        {
+            float scale = stbtt_ScaleForPixelHeight(&font, sizes[s]);
+            int padding = paddings[s];
+
+            Stats stats[NUM_GENERATORS] = {};
+            for (int glyph = 0; glyph < font.numGlyphs; ++glyph)
+                CompareGlyph(&font, glyph, scale, padding, edge, stats);
+
+            for (int k = SDF_KERNEL_SCALAR; k < NUM_GENERATORS; ++k)
+            {
+                if (!stats[k].m_Pixels)
+                    continue;
+                float mean_diff = stats[k].m_TotalDiff / (float)stats[k].m_Pixels;
+                float mean_error = mean_diff * padding / (float)edge; // in pixels
+                bool ok = k == GENERATOR_RASTER ? mean_error <= RASTER_MEAN_TOLERANCE : stats[k].m_MaxDiff <= TOLERANCE;
+                failures += ok ? 0 : 1;
+                printf("%s %s size: %d padding: %d  pixels: %ld differing: %ld mean diff: %.3f (%.3f px) max diff: %d  %s\n", ok ? "OK  " : "FAIL",
+                        generator_names[k], sizes[s], padding, stats[k].m_Pixels, stats[k].m_Differing, mean_diff, mean_error, stats[k].m_MaxDiff, argv[f]);
+            }
+        }
+        free(data);
+    }
+
+    printf("%s row slices: %d mismatching glyphs\n", g_RowSliceMismatches ? "FAIL" : "OK  ", g_RowSliceMismatches);
+    failures += g_RowSliceMismatches ? 1 : 0;
+    printf("%s shared distance field: %d mismatching glyphs\n", g_SharedFieldMismatches ? "FAIL" : "OK  ", g_SharedFieldMismatches);
+    failures += g_SharedFieldMismatches ? 1 : 0;
+    printf("%s blur radius: %.1f max diff: %d\n", g_BlurMaxDiff <= TOLERANCE ? "OK  " : "FAIL", BLUR_RADIUS, g_BlurMaxDiff);
+    failures += g_BlurMaxDiff <= TOLERANCE ? 0 : 1;
+    float msdf_fallbacks = g_MsdfEdgePixels ? g_MsdfFallbacks / (float)g_MsdfEdgePixels : 0.0f;
+    bool msdf_ok = g_MsdfSignMismatches == 0 && msdf_fallbacks <= MSDF_FALLBACK_TOLERANCE;
+    printf("%s msdf pixels: %ld sign mismatches: %ld fallbacks: %.3f\n", msdf_ok ? "OK  " : "FAIL", g_MsdfPixels, g_MsdfSignMismatches, msdf_fallbacks);
+    failures += msdf_ok ? 0 : 1;
+
+    SdfSetKernel(SDF_KERNEL_AUTO);
+    return failures ? 1 : 0;
+}